@@ -0,0 +1,140 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+// Compares DAryHeap with std::priority_queue on the access pattern of the routers' A* searches: for each arc, the
+// queue is reset, then repeatedly popped, with a few wires pushed per pop at a cost a little above the popped one.
+//
+// Usage: nextpnr-bench-dary-heap [arcs] [pops per arc] [pushes per pop]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <vector>
+
+#include "dary_heap.h"
+
+USING_NEXTPNR_NAMESPACE
+
+namespace {
+
+// The same layout and ordering as the routers' QueuedWire
+struct QueuedWire
+{
+    int wire;
+    float cost;
+    float togo;
+    int randtag;
+
+    struct Greater
+    {
+        bool operator()(const QueuedWire &lhs, const QueuedWire &rhs) const
+        {
+            float lhs_score = lhs.cost + lhs.togo, rhs_score = rhs.cost + rhs.togo;
+            return lhs_score == rhs_score ? lhs.randtag > rhs.randtag : lhs_score > rhs_score;
+        }
+    };
+};
+
+struct XorShift
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return uint32_t(state >> 32);
+    }
+    float uniform() { return float(next() & 0xFFFFFF) / float(0x1000000); }
+};
+
+struct Pattern
+{
+    int arcs, pops, pushes;
+};
+
+// Reset the queue as the routers did before DAryHeap, by swapping with a new one
+template <typename T, typename C> void reset(std::priority_queue<T, std::vector<T>, C> &queue)
+{
+    if (!queue.empty()) {
+        std::priority_queue<T, std::vector<T>, C> new_queue;
+        queue.swap(new_queue);
+    }
+}
+
+template <typename T, typename C, size_t A> void reset(DAryHeap<T, C, A> &queue)
+{
+    queue.clear();
+}
+
+// Returns the time taken in seconds, and a checksum of the popped wires so the work can't be optimised away
+template <typename Queue> double run(const Pattern &p, uint64_t &checksum)
+{
+    XorShift rng;
+    Queue queue;
+    checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int arc = 0; arc < p.arcs; arc++) {
+        reset(queue);
+        queue.push(QueuedWire{0, 0, rng.uniform() * 100, int(rng.next())});
+        for (int i = 0; i < p.pops && !queue.empty(); i++) {
+            QueuedWire curr = queue.top();
+            queue.pop();
+            checksum = checksum * 31 + uint64_t(curr.wire);
+            for (int j = 0; j < p.pushes; j++) {
+                float delay = 0.5f + rng.uniform();
+                float togo = curr.togo + (rng.uniform() - 0.6f) * 2.0f;
+                queue.push(QueuedWire{int(rng.next() & 0xFFFFF), curr.cost + delay, togo < 0 ? 0 : togo,
+                                      int(rng.next())});
+            }
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Queue> void report(const char *name, const Pattern &p, uint64_t &expected)
+{
+    uint64_t checksum;
+    double time = run<Queue>(p, checksum);
+    printf("%-22s %8.3fs%s\n", name, time, checksum == expected ? "" : "  (different pop order)");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Pattern p{2000, 3000, 6};
+    if (argc > 1)
+        p.arcs = atoi(argv[1]);
+    if (argc > 2)
+        p.pops = atoi(argv[2]);
+    if (argc > 3)
+        p.pushes = atoi(argv[3]);
+    printf("%d arcs, %d pops per arc, %d pushes per pop\n", p.arcs, p.pops, p.pushes);
+
+    uint64_t expected;
+    double time = run<std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater>>(p, expected);
+    printf("%-22s %8.3fs\n", "std::priority_queue", time);
+    report<DAryHeap<QueuedWire, QueuedWire::Greater, 2>>("2-ary DAryHeap", p, expected);
+    report<DAryHeap<QueuedWire, QueuedWire::Greater, 4>>("4-ary DAryHeap", p, expected);
+    report<DAryHeap<QueuedWire, QueuedWire::Greater, 8>>("8-ary DAryHeap", p, expected);
+    return 0;
+}
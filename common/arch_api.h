@@ -76,6 +76,8 @@ template <typename R> struct ArchAPI : BaseCtx
     virtual typename R::UphillPipRangeT getPipsUphill(WireId wire) const = 0;
     virtual typename R::WireBelPinRangeT getWireBelPins(WireId wire) const = 0;
     virtual uint32_t getWireChecksum(WireId wire) const = 0;
+    virtual int getWireIndexCount() const = 0;
+    virtual int getWireIndex(WireId wire) const = 0;
     virtual void bindWire(WireId wire, NetInfo *net, PlaceStrength strength) = 0;
     virtual void unbindWire(WireId wire) = 0;
     virtual bool checkWireAvail(WireId wire) const = 0;
@@ -136,6 +138,7 @@ template <typename R> struct ArchAPI : BaseCtx
     virtual BelBucketId getBelBucketForBel(BelId bel) const = 0;
     virtual BelBucketId getBelBucketForCellType(IdString cell_type) const = 0;
     virtual bool isBelLocationValid(BelId bel) const = 0;
+    virtual bool isBelBindLocal(BelId bel) const = 0;
     virtual typename R::CellTypeRangeT getCellTypes() const = 0;
     virtual typename R::BelBucketRangeT getBelBuckets() const = 0;
     virtual typename R::BucketBelRangeT getBelsInBucket(BelBucketId bucket) const = 0;
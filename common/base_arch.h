@@ -166,6 +166,8 @@ template <typename R> struct BaseArch : ArchAPI<R>
         return empty_if_possible<typename R::WireAttrsRangeT>();
     }
     virtual uint32_t getWireChecksum(WireId wire) const override { return uint32_t(std::hash<WireId>()(wire)); }
+    virtual int getWireIndexCount() const override { return -1; }
+    virtual int getWireIndex(WireId wire) const override { NPNR_ASSERT_FALSE("unsupported"); }
 
     virtual void bindWire(WireId wire, NetInfo *net, PlaceStrength strength) override
     {
@@ -327,6 +329,7 @@ template <typename R> struct BaseArch : ArchAPI<R>
         return getBelBucketByName(cell_type);
     };
     virtual bool isBelLocationValid(BelId bel) const override { return true; }
+    virtual bool isBelBindLocal(BelId bel) const override { return false; }
     virtual typename R::CellTypeRangeT getCellTypes() const override
     {
         NPNR_ASSERT(cell_types_initialised);
@@ -28,7 +28,9 @@
 #include <boost/thread.hpp>
 #endif
 
+#include "cached_order_map.h"
 #include "idstring.h"
+#include "idstring_db.h"
 #include "nextpnr_namespaces.h"
 #include "nextpnr_types.h"
 #include "property.h"
@@ -52,8 +54,7 @@ struct BaseCtx
 #endif
 
     // ID String database.
-    mutable std::unordered_map<std::string, int> *idstring_str_to_idx;
-    mutable std::vector<const std::string *> *idstring_idx_to_str;
+    mutable IdStringDb *idstring_db;
 
     // Temporary string backing store for logging
     mutable StrRingBuffer log_strs;
@@ -62,8 +63,8 @@ struct BaseCtx
     std::unordered_map<IdString, Property> settings;
 
     // Placed nets and cells.
-    std::unordered_map<IdString, std::unique_ptr<NetInfo>> nets;
-    std::unordered_map<IdString, std::unique_ptr<CellInfo>> cells;
+    CachedOrderMap<IdString, std::unique_ptr<NetInfo>> nets;
+    CachedOrderMap<IdString, std::unique_ptr<CellInfo>> cells;
 
     // Hierarchical (non-leaf) cells by full path
     std::unordered_map<IdString, HierarchicalCell> hierarchy;
@@ -90,8 +91,7 @@ struct BaseCtx
 
     BaseCtx()
     {
-        idstring_str_to_idx = new std::unordered_map<std::string, int>;
-        idstring_idx_to_str = new std::vector<const std::string *>;
+        idstring_db = new IdStringDb;
         IdString::initialize_add(this, "", 0);
         IdString::initialize_arch(this);
 
@@ -100,8 +100,7 @@ struct BaseCtx
 
     virtual ~BaseCtx()
     {
-        delete idstring_str_to_idx;
-        delete idstring_idx_to_str;
+        delete idstring_db;
     }
 
     // Must be called before performing any mutating changes on the Ctx/Arch.
@@ -190,12 +189,19 @@ struct BaseCtx
     std::unordered_set<WireId> wireUiReload;
     std::unordered_set<PipId> pipUiReload;
     std::unordered_set<GroupId> groupUiReload;
+    // Set while bels are being bound from several threads at once; bel refreshes are dropped, and whoever set it
+    // should call refreshUi() afterwards
+    bool belUiReloadDeferred = false;
 
     void refreshUi() { allUiReload = true; }
 
     void refreshUiFrame() { frameUiReload = true; }
 
-    void refreshUiBel(BelId bel) { belUiReload.insert(bel); }
+    void refreshUiBel(BelId bel)
+    {
+        if (!belUiReloadDeferred)
+            belUiReload.insert(bel);
+    }
 
     void refreshUiWire(WireId wire) { wireUiReload.insert(wire); }
 
@@ -0,0 +1,138 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef CACHED_ORDER_MAP_H
+#define CACHED_ORDER_MAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#ifndef NPNR_DISABLE_THREADS
+#include <mutex>
+#endif
+
+#include "nextpnr_namespaces.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// A std::unordered_map that also caches the key order of its entries, until the next insertion or erasure. Repeatedly
+// iterating over an unchanged map in sorted order (which placers and timing analysis do every iteration) then doesn't
+// sort it every time. Every modifying member of std::unordered_map that can add or remove an entry is wrapped to
+// invalidate the cache, so the map must not be modified through a reference to the base class.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class CachedOrderMap : public std::unordered_map<K, V, Hash>
+{
+    typedef std::unordered_map<K, V, Hash> base_t;
+
+  public:
+    typedef typename base_t::value_type value_type;
+
+    CachedOrderMap() = default;
+    CachedOrderMap(const CachedOrderMap &other) : base_t(other) {}
+    CachedOrderMap(CachedOrderMap &&other) noexcept : base_t(std::move(other)) { other.invalidate(); }
+    CachedOrderMap &operator=(const CachedOrderMap &other)
+    {
+        invalidate();
+        base_t::operator=(other);
+        return *this;
+    }
+    CachedOrderMap &operator=(CachedOrderMap &&other) noexcept
+    {
+        invalidate();
+        other.invalidate();
+        base_t::operator=(std::move(other));
+        return *this;
+    }
+
+    V &operator[](const K &key)
+    {
+        size_t old_size = this->size();
+        V &value = base_t::operator[](key);
+        if (this->size() != old_size)
+            invalidate();
+        return value;
+    }
+    template <typename... Args> decltype(auto) insert(Args &&...args)
+    {
+        invalidate();
+        return base_t::insert(std::forward<Args>(args)...);
+    }
+    template <typename... Args> decltype(auto) emplace(Args &&...args)
+    {
+        invalidate();
+        return base_t::emplace(std::forward<Args>(args)...);
+    }
+    template <typename... Args> decltype(auto) emplace_hint(Args &&...args)
+    {
+        invalidate();
+        return base_t::emplace_hint(std::forward<Args>(args)...);
+    }
+    template <typename... Args> decltype(auto) erase(Args &&...args)
+    {
+        invalidate();
+        return base_t::erase(std::forward<Args>(args)...);
+    }
+    void clear()
+    {
+        invalidate();
+        base_t::clear();
+    }
+    void swap(CachedOrderMap &other)
+    {
+        invalidate();
+        other.invalidate();
+        base_t::swap(other);
+    }
+
+    // All the entries, in key order. The result is valid until the next insertion or erasure; it is safe for several
+    // threads to call this at once, as long as none of them is modifying the map
+    const std::vector<const value_type *> &sorted_entries() const
+    {
+        if (!sorted_valid.load(std::memory_order_acquire)) {
+#ifndef NPNR_DISABLE_THREADS
+            std::lock_guard<std::mutex> lock(sorted_mutex);
+#endif
+            if (!sorted_valid.load(std::memory_order_relaxed)) {
+                sorted_kv.clear();
+                sorted_kv.reserve(this->size());
+                for (const auto &kv : *this)
+                    sorted_kv.push_back(&kv);
+                std::sort(sorted_kv.begin(), sorted_kv.end(),
+                          [](const value_type *a, const value_type *b) { return a->first < b->first; });
+                sorted_valid.store(true, std::memory_order_release);
+            }
+        }
+        return sorted_kv;
+    }
+
+  private:
+    void invalidate() { sorted_valid.store(false); }
+
+    mutable std::vector<const value_type *> sorted_kv;
+    mutable std::atomic<bool> sorted_valid{false};
+#ifndef NPNR_DISABLE_THREADS
+    mutable std::mutex sorted_mutex;
+#endif
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif /* CACHED_ORDER_MAP_H */
@@ -35,6 +35,7 @@
 #include <iostream>
 #include "command.h"
 #include "design_utils.h"
+#include "embed.h"
 #include "json_frontend.h"
 #include "jsonwrite.h"
 #include "log.h"
@@ -94,6 +95,9 @@ bool CommandHandler::executeBeforeContext()
             log_error("Failed to open log file '%s' for writing.\n", logfilename.c_str());
         log_streams.push_back(std::make_pair(&logfile, LogLevel::LOG_MSG));
     }
+
+    if (vm.count("chipdb"))
+        set_chipdb_override(vm["chipdb"].as<std::string>());
     return false;
 }
 
@@ -126,6 +130,8 @@ po::options_description CommandHandler::getGeneralOptions()
     general.add_options()("top", po::value<std::string>(), "name of top module");
     general.add_options()("seed", po::value<int>(), "seed value for random number generator");
     general.add_options()("randomize-seed,r", "randomize seed value for random number generator");
+    general.add_options()("threads", po::value<int>(),
+                          "number of threads to use for parallel algorithms (default: number of hardware threads)");
 
     general.add_options()(
             "placer", po::value<std::string>(),
@@ -143,6 +149,7 @@ po::options_description CommandHandler::getGeneralOptions()
     general.add_options()("cstrweight", po::value<float>(), "placer weighting for relative constraint satisfaction");
     general.add_options()("starttemp", po::value<float>(), "placer SA start temperature");
     general.add_options()("placer-budgets", "use budget rather than criticality in placer timing weights");
+    general.add_options()("placer1-parallel", "run SA placer moves in parallel within tiles of the device");
 
     general.add_options()("pack-only", "pack design only without placement or routing");
     general.add_options()("no-route", "process design without routing");
@@ -151,6 +158,9 @@ po::options_description CommandHandler::getGeneralOptions()
 
     general.add_options()("ignore-loops", "ignore combinational loops in timing analysis");
 
+    general.add_options()("chipdb", po::value<std::string>(),
+                          "chip database binary to map at runtime, instead of the built-in one (its file name must "
+                          "match, e.g. chipdb-5k.bin for an iCE40 UP5K)");
     general.add_options()("version,V", "show version");
     general.add_options()("test", "check architecture database integrity");
     general.add_options()("freq", po::value<double>(), "set target frequency for design in MHz");
@@ -169,6 +179,14 @@ po::options_description CommandHandler::getGeneralOptions()
 
     general.add_options()("placed-svg", po::value<std::string>(), "write render of placement to SVG file");
     general.add_options()("routed-svg", po::value<std::string>(), "write render of routing to SVG file");
+    general.add_options()("reuse-routing", po::value<std::string>(),
+                          "JSON file written by --write from a previous run, whose routing router2 keeps for all arcs "
+                          "that are still valid");
+    general.add_options()("router-lookahead",
+                          "build (or load from the cache) sampled delay tables for the router's delay estimates, on "
+                          "architectures that support them");
+    general.add_options()("router-lookahead-cache", po::value<std::string>(),
+                          "directory for cached router lookahead tables (default: ~/.cache/nextpnr)");
 
     return general;
 }
@@ -208,6 +226,22 @@ void CommandHandler::setupContext(Context *ctx)
         ctx->rngseed(r);
     }
 
+    if (vm.count("threads")) {
+        ctx->settings[ctx->id("threads")] = vm["threads"].as<int>();
+    }
+
+    if (vm.count("reuse-routing")) {
+        ctx->settings[ctx->id("router2/reuseRouting")] = vm["reuse-routing"].as<std::string>();
+    }
+
+    if (vm.count("router-lookahead")) {
+        ctx->settings[ctx->id("router/lookahead")] = true;
+    }
+
+    if (vm.count("router-lookahead-cache")) {
+        ctx->settings[ctx->id("router/lookaheadCache")] = vm["router-lookahead-cache"].as<std::string>();
+    }
+
     if (vm.count("slack_redist_iter")) {
         ctx->settings[ctx->id("slack_redist_iter")] = vm["slack_redist_iter"].as<int>();
         if (vm.count("freq") && vm["freq"].as<double>() == 0) {
@@ -255,6 +289,9 @@ void CommandHandler::setupContext(Context *ctx)
     if (vm.count("placer-budgets")) {
         ctx->settings[ctx->id("placer1/budgetBased")] = true;
     }
+    if (vm.count("placer1-parallel")) {
+        ctx->settings[ctx->id("placer1/parallel")] = true;
+    }
     if (vm.count("freq")) {
         auto freq = vm["freq"].as<double>();
         if (freq > 0)
@@ -447,6 +484,7 @@ int CommandHandler::exec()
         setupContext(ctx.get());
         setupArchContext(ctx.get());
         int rc = executeMain(std::move(ctx));
+        log_chipdb_residency();
         printFooter();
         log_break();
         log_info("Program finished normally.\n");
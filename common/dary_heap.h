@@ -0,0 +1,119 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef DARY_HEAP_H
+#define DARY_HEAP_H
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "nextpnr_namespaces.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// A d-ary heap with the same interface and ordering as std::priority_queue: top() is the element that compares
+// greatest under Compare, so a "greater than" comparison gives a min-heap. With the default arity of 4 the tree is half
+// as deep as a binary heap and the children of a node share a cache line, which makes pop() noticeably cheaper for the
+// large queues of the routers' A* searches.
+//
+// Unlike std::priority_queue, clear() keeps the underlying storage, so a queue that is reused for every arc doesn't
+// need to be reallocated each time.
+template <typename T, typename Compare = std::less<T>, size_t Arity = 4> class DAryHeap
+{
+  public:
+    static_assert(Arity >= 2, "heap arity must be at least 2");
+
+    explicit DAryHeap(const Compare &cmp = Compare()) : cmp(cmp) {}
+
+    bool empty() const { return data.empty(); }
+    size_t size() const { return data.size(); }
+    // As with std::priority_queue, top() and pop() must not be called on an empty heap
+    const T &top() const { return data.front(); }
+
+    void push(const T &value)
+    {
+        data.push_back(value);
+        sift_up(data.size() - 1);
+    }
+    void push(T &&value)
+    {
+        data.push_back(std::move(value));
+        sift_up(data.size() - 1);
+    }
+    template <typename... Args> void emplace(Args &&...args)
+    {
+        data.emplace_back(std::forward<Args>(args)...);
+        sift_up(data.size() - 1);
+    }
+
+    void pop()
+    {
+        T last = std::move(data.back());
+        data.pop_back();
+        if (!data.empty())
+            sift_down(std::move(last));
+    }
+
+    void clear() { data.clear(); }
+    void reserve(size_t n) { data.reserve(n); }
+
+  private:
+    std::vector<T> data;
+    Compare cmp;
+
+    void sift_up(size_t i)
+    {
+        T value = std::move(data[i]);
+        while (i > 0) {
+            size_t parent = (i - 1) / Arity;
+            if (!cmp(data[parent], value))
+                break;
+            data[i] = std::move(data[parent]);
+            i = parent;
+        }
+        data[i] = std::move(value);
+    }
+
+    // Place value, which replaces the root, by moving the hole at the root down the tree
+    void sift_down(T value)
+    {
+        size_t i = 0, n = data.size();
+        while (true) {
+            size_t first = i * Arity + 1;
+            if (first >= n)
+                break;
+            size_t last = std::min(first + Arity, n);
+            size_t best = first;
+            for (size_t c = first + 1; c < last; c++)
+                if (cmp(data[best], data[c]))
+                    best = c;
+            if (!cmp(value, data[best]))
+                break;
+            data[i] = std::move(data[best]);
+            i = best;
+        }
+        data[i] = std::move(value);
+    }
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
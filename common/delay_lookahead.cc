@@ -0,0 +1,328 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "delay_lookahead.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include "log.h"
+#include "nextpnr.h"
+#include "thread_pool.h"
+#include "util.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+const char cache_magic[8] = {'N', 'P', 'N', 'R', 'L', 'A', '0', '1'};
+
+// FNV-1a, which (unlike std::hash) is the same between runs and builds, as the cache fingerprint must be
+struct Fingerprint
+{
+    uint64_t value = 0xcbf29ce484222325ULL;
+
+    void add_bytes(const void *data, size_t size)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++) {
+            value ^= bytes[i];
+            value *= 0x100000001b3ULL;
+        }
+    }
+    template <typename T> void add(const T &x) { add_bytes(&x, sizeof(T)); }
+};
+
+// Whether the router might be heading for this wire, as the sink of an arc
+bool is_input_pin_wire(const Context *ctx, WireId wire)
+{
+    for (auto bp : ctx->getWireBelPins(wire))
+        if (ctx->getBelPinType(bp.bel, bp.pin) == PORT_IN)
+            return true;
+    return false;
+}
+
+struct QueuedWire
+{
+    delay_t delay;
+    WireId wire;
+    bool operator>(const QueuedWire &other) const { return delay > other.delay; }
+};
+
+std::string default_cache_dir()
+{
+    const char *xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg != nullptr && *xdg != '\0')
+        return std::string(xdg) + "/nextpnr";
+    const char *home = std::getenv("HOME");
+    if (home != nullptr && *home != '\0')
+        return std::string(home) + "/.cache/nextpnr";
+    return "";
+}
+} // namespace
+
+const int DelayLookahead::max_dist;
+const int DelayLookahead::samples_per_class;
+const int DelayLookahead::max_visited;
+const int DelayLookahead::table_dim;
+
+int DelayLookahead::class_of(const std::string &name)
+{
+    size_t end = name.size();
+    while (end > 0 && std::isdigit(static_cast<unsigned char>(name[end - 1])))
+        --end;
+    auto found = class_ids.find(name.substr(0, end));
+    if (found != class_ids.end())
+        return found->second;
+    int cls = int(class_names.size());
+    class_names.push_back(name.substr(0, end));
+    class_ids[class_names.back()] = cls;
+    return cls;
+}
+
+bool DelayLookahead::enabled(Context *ctx)
+{
+    return bool_or_default(ctx->settings, ctx->id("router/lookahead"), false);
+}
+
+void DelayLookahead::init(Context *ctx, const std::string &db_name, std::function<LookaheadWire(WireId)> wire_info)
+{
+    is_ready = false;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Classify every wire, fingerprinting the routing graph as we go, and pick the sample wires of each class: those
+    // at distinct locations closest to the middle of the device
+    Fingerprint fp;
+    fp.add_bytes(db_name.data(), db_name.size());
+    fp.add(int32_t(sizeof(delay_t)));
+    fp.add(int32_t(max_dist));
+    fp.add(int32_t(samples_per_class));
+    fp.add(int32_t(max_visited));
+
+    struct Candidate
+    {
+        int dist;
+        LookaheadWire info;
+        WireId wire;
+    };
+    std::vector<std::vector<Candidate>> candidates(num_classes());
+    int mid_x = ctx->getGridDimX() / 2, mid_y = ctx->getGridDimY() / 2;
+    for (auto wire : ctx->getWires()) {
+        LookaheadWire info = wire_info(wire);
+        fp.add(int32_t(info.cls));
+        fp.add(int32_t(info.x));
+        fp.add(int32_t(info.y));
+        if (info.cls < 0 || info.cls >= num_classes())
+            continue;
+        auto &cands = candidates.at(info.cls);
+        int dist = std::abs(info.x - mid_x) + std::abs(info.y - mid_y);
+        if (int(cands.size()) == samples_per_class && dist >= cands.back().dist)
+            continue;
+        if (std::any_of(cands.begin(), cands.end(),
+                        [&](const Candidate &c) { return c.info.x == info.x && c.info.y == info.y; }))
+            continue;
+        if (int(cands.size()) == samples_per_class)
+            cands.pop_back();
+        auto pos = std::upper_bound(cands.begin(), cands.end(), dist,
+                                    [](int d, const Candidate &c) { return d < c.dist; });
+        cands.insert(pos, Candidate{dist, info, wire});
+    }
+    int64_t num_pips = 0;
+    for (auto pip : ctx->getPips()) {
+        fp.add(ctx->getPipDelay(pip).maxDelay());
+        ++num_pips;
+    }
+    fp.add(num_pips);
+
+    std::string cache_dir = str_or_default(ctx->settings, ctx->id("router/lookaheadCache"), default_cache_dir());
+    std::string cache_file;
+    if (!cache_dir.empty()) {
+        std::string safe_name = db_name;
+        std::replace(safe_name.begin(), safe_name.end(), '/', '_');
+        cache_file = cache_dir + "/" + safe_name + ".lookahead";
+    }
+
+    if (!cache_file.empty() && read_cache(cache_file, fp.value)) {
+        log_info("Read delay lookahead from '%s'.\n", cache_file.c_str());
+    } else {
+        std::vector<std::vector<WireId>> samples(num_classes());
+        for (int cls = 0; cls < num_classes(); cls++)
+            for (auto &c : candidates.at(cls))
+                samples.at(cls).push_back(c.wire);
+        log_info("Building delay lookahead for %d wire classes...\n", num_classes());
+        build(ctx, wire_info, samples);
+        auto end = std::chrono::high_resolution_clock::now();
+        log_info("Built delay lookahead in %.02fs.\n", std::chrono::duration<float>(end - start).count());
+        if (!cache_file.empty())
+            write_cache(cache_file, fp.value);
+    }
+    is_ready = true;
+}
+
+void DelayLookahead::build(Context *ctx, const std::function<LookaheadWire(WireId)> &wire_info,
+                           const std::vector<std::vector<WireId>> &samples)
+{
+    std::vector<std::pair<int, WireId>> sources;
+    for (int cls = 0; cls < num_classes(); cls++)
+        for (auto wire : samples.at(cls))
+            sources.emplace_back(cls, wire);
+
+    // Search from each sample wire independently, each into its own table so the result doesn't depend on scheduling
+    std::vector<std::vector<delay_t>> results(sources.size());
+    ThreadPool pool(ThreadPool::default_threads(ctx));
+    pool.parallel_for(
+            0, sources.size(),
+            [&](size_t i) {
+                WireId src = sources.at(i).second;
+                LookaheadWire src_info = wire_info(src);
+                std::vector<delay_t> &result = results.at(i);
+                result.assign(table_dim * table_dim, -1);
+
+                std::unordered_map<WireId, delay_t> best;
+                std::priority_queue<QueuedWire, std::vector<QueuedWire>, std::greater<QueuedWire>> queue;
+                best[src] = 0;
+                queue.push(QueuedWire{0, src});
+                int visited = 0;
+                while (!queue.empty() && visited < max_visited) {
+                    QueuedWire curr = queue.top();
+                    queue.pop();
+                    if (curr.delay > best.at(curr.wire))
+                        continue;
+                    ++visited;
+                    LookaheadWire info = wire_info(curr.wire);
+                    int dx = info.x - src_info.x, dy = info.y - src_info.y;
+                    // Don't follow routing that has left the area covered by the table
+                    if (std::abs(dx) > max_dist || std::abs(dy) > max_dist)
+                        continue;
+                    if (is_input_pin_wire(ctx, curr.wire)) {
+                        delay_t &entry = result.at((dy + max_dist) * table_dim + dx + max_dist);
+                        if (entry < 0 || curr.delay < entry)
+                            entry = curr.delay;
+                    }
+                    for (auto pip : ctx->getPipsDownhill(curr.wire)) {
+                        WireId next = ctx->getPipDstWire(pip);
+                        delay_t next_delay =
+                                curr.delay + ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(next).maxDelay();
+                        auto found = best.find(next);
+                        if (found != best.end() && found->second <= next_delay)
+                            continue;
+                        best[next] = next_delay;
+                        queue.push(QueuedWire{next_delay, next});
+                    }
+                }
+            },
+            1);
+
+    table.assign(size_t(num_classes()) * table_dim * table_dim, -1);
+    for (size_t i = 0; i < sources.size(); i++) {
+        delay_t *cls_table = table.data() + size_t(sources.at(i).first) * table_dim * table_dim;
+        for (int j = 0; j < table_dim * table_dim; j++) {
+            delay_t d = results.at(i).at(j);
+            if (d >= 0 && (cls_table[j] < 0 || d < cls_table[j]))
+                cls_table[j] = d;
+        }
+    }
+
+    // Beyond the table, assume the slowest growth in delay with distance seen in its outer half
+    per_tile.assign(num_classes(), -1);
+    for (int cls = 0; cls < num_classes(); cls++) {
+        for (int dy = -max_dist; dy <= max_dist; dy++) {
+            for (int dx = -max_dist; dx <= max_dist; dx++) {
+                int dist = std::abs(dx) + std::abs(dy);
+                delay_t d = table.at((size_t(cls) * table_dim + dy + max_dist) * table_dim + dx + max_dist);
+                if (d < 0 || dist < max_dist / 2)
+                    continue;
+                delay_t rate = d / dist;
+                if (per_tile.at(cls) < 0 || rate < per_tile.at(cls))
+                    per_tile.at(cls) = rate;
+            }
+        }
+    }
+}
+
+delay_t DelayLookahead::estimate(const LookaheadWire &src, const LookaheadWire &dst) const
+{
+    if (!is_ready || src.cls < 0 || src.cls >= num_classes())
+        return -1;
+    int dx = dst.x - src.x, dy = dst.y - src.y;
+    int clamp_dx = std::max(-max_dist, std::min(max_dist, dx)), clamp_dy = std::max(-max_dist, std::min(max_dist, dy));
+    delay_t d = table[(size_t(src.cls) * table_dim + clamp_dy + max_dist) * table_dim + clamp_dx + max_dist];
+    if (d < 0)
+        return -1;
+    int beyond = std::abs(dx - clamp_dx) + std::abs(dy - clamp_dy);
+    if (beyond > 0) {
+        if (per_tile[src.cls] < 0)
+            return -1;
+        d += beyond * per_tile[src.cls];
+    }
+    return d;
+}
+
+bool DelayLookahead::read_cache(const std::string &filename, uint64_t fingerprint)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        return false;
+    char magic[sizeof(cache_magic)];
+    uint64_t file_fingerprint;
+    int32_t file_classes;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char *>(&file_fingerprint), sizeof(file_fingerprint));
+    in.read(reinterpret_cast<char *>(&file_classes), sizeof(file_classes));
+    if (!in || std::memcmp(magic, cache_magic, sizeof(magic)) != 0 || file_fingerprint != fingerprint ||
+        file_classes != num_classes())
+        return false;
+    table.resize(size_t(num_classes()) * table_dim * table_dim);
+    per_tile.resize(num_classes());
+    in.read(reinterpret_cast<char *>(table.data()), table.size() * sizeof(delay_t));
+    in.read(reinterpret_cast<char *>(per_tile.data()), per_tile.size() * sizeof(delay_t));
+    return bool(in);
+}
+
+void DelayLookahead::write_cache(const std::string &filename, uint64_t fingerprint) const
+{
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(boost::filesystem::path(filename).parent_path(), ec);
+    // Write to a temporary file and rename it into place, so concurrent runs never see a partial file
+    std::string tmp_filename = boost::filesystem::unique_path(filename + ".%%%%-%%%%.tmp").string();
+    {
+        std::ofstream out(tmp_filename, std::ios::binary);
+        int32_t classes = num_classes();
+        out.write(cache_magic, sizeof(cache_magic));
+        out.write(reinterpret_cast<const char *>(&fingerprint), sizeof(fingerprint));
+        out.write(reinterpret_cast<const char *>(&classes), sizeof(classes));
+        out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(delay_t));
+        out.write(reinterpret_cast<const char *>(per_tile.data()), per_tile.size() * sizeof(delay_t));
+        if (!out) {
+            out.close();
+            boost::filesystem::remove(tmp_filename, ec);
+            log_warning("Failed to write delay lookahead cache '%s'.\n", filename.c_str());
+            return;
+        }
+    }
+    boost::filesystem::rename(tmp_filename, filename, ec);
+    if (ec)
+        log_warning("Failed to write delay lookahead cache '%s'.\n", filename.c_str());
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,92 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef DELAY_LOOKAHEAD_H
+#define DELAY_LOOKAHEAD_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nextpnr_namespaces.h"
+#include "nextpnr_types.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// A wire as seen by the lookahead: its class, and the location it is considered to be at. Wires of the same class are
+// assumed to have similar routing onwards from them, relative to that location.
+struct LookaheadWire
+{
+    int cls = -1;
+    int x = 0, y = 0;
+};
+
+// An architecture-independent routing delay lookahead, for tighter estimateDelay heuristics than a distance formula.
+//
+// It is built by running Dijkstra searches, in parallel, from a few sample wires of each class near the middle of the
+// device, and recording the smallest delay to reach a BEL input pin at each (dx, dy) offset within max_dist of the
+// source. Beyond that range, the delay is extrapolated from the slowest growth seen at the edge of the table.
+//
+// Building it can take some time on a large device, so the tables are cached on disk, keyed by a fingerprint of the
+// database taken while classifying the wires.
+class DelayLookahead
+{
+  public:
+    // Get the class for a tile-relative wire name. Names are classed by removing any trailing digits, so (for
+    // example) all the tracks of a bundle of routing wires share a class. Not thread safe; call before init
+    int class_of(const std::string &name);
+    int num_classes() const { return int(class_names.size()); }
+
+    // Whether the lookahead has been requested, by the "router/lookahead" setting
+    static bool enabled(Context *ctx);
+    // Build the lookahead, or read it from the cache. wire_info must give the class (from class_of) and location of
+    // any wire, and must be safe to call from several threads at once. db_name identifies the device, and is used as
+    // the cache file name
+    void init(Context *ctx, const std::string &db_name, std::function<LookaheadWire(WireId)> wire_info);
+    bool ready() const { return is_ready; }
+
+    // Estimated delay from src to a BEL input pin on, or near, dst; or -1 if the lookahead has no estimate for them
+    delay_t estimate(const LookaheadWire &src, const LookaheadWire &dst) const;
+
+  private:
+    static const int max_dist = 24;
+    static const int samples_per_class = 4;
+    static const int max_visited = 200000;
+    static const int table_dim = 2 * max_dist + 1;
+
+    bool is_ready = false;
+    std::unordered_map<std::string, int> class_ids;
+    std::vector<std::string> class_names;
+
+    // Smallest delay from a wire of each class to an input pin at each offset, or -1 if none was found; indexed by
+    // (cls * table_dim + dy + max_dist) * table_dim + dx + max_dist
+    std::vector<delay_t> table;
+    // Delay per tile of distance for offsets beyond the table, for each class, or -1 if unknown
+    std::vector<delay_t> per_tile;
+
+    void build(Context *ctx, const std::function<LookaheadWire(WireId)> &wire_info,
+               const std::vector<std::vector<WireId>> &samples);
+    bool read_cache(const std::string &filename, uint64_t fingerprint);
+    void write_cache(const std::string &filename, uint64_t fingerprint) const;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif /* DELAY_LOOKAHEAD_H */
@@ -85,6 +85,28 @@ void print_utilisation(const Context *ctx)
     log_break();
 }
 
+std::vector<PipId> get_bound_pips(const Context *ctx)
+{
+    std::vector<PipId> pips;
+    for (auto &net : ctx->nets) {
+        for (auto &wire : net.second->wires) {
+            if (wire.second.pip != PipId())
+                pips.push_back(wire.second.pip);
+        }
+    }
+    return pips;
+}
+
+std::vector<WireId> get_bound_wires(const Context *ctx)
+{
+    std::vector<WireId> wires;
+    for (auto &net : ctx->nets) {
+        for (auto &wire : net.second->wires)
+            wires.push_back(wire.first);
+    }
+    return wires;
+}
+
 // Connect a net to a port
 void connect_port(const Context *ctx, NetInfo *net, CellInfo *cell, IdString port_name)
 {
@@ -106,6 +106,13 @@ void rename_net(Context *ctx, NetInfo *net, IdString new_name);
 
 void print_utilisation(const Context *ctx);
 
+// Get every pip bound to a net, in no particular order. This walks the routing of each net, so is much cheaper than
+// checking getBoundPipNet for every pip in the device when only a fraction of them are used
+std::vector<PipId> get_bound_pips(const Context *ctx);
+
+// Get every wire bound to a net, in no particular order
+std::vector<WireId> get_bound_wires(const Context *ctx);
+
 // Disconnect a bus of nets (if connected) from old, and connect it to the new ports
 void replace_bus(Context *ctx, CellInfo *old_cell, IdString old_name, int old_offset, bool old_brackets,
                  CellInfo *new_cell, IdString new_name, int new_offset, bool new_brackets, int width);
@@ -1,32 +1,97 @@
 #if defined(WIN32)
 #include <windows.h>
+#elif !defined(__wasi__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define CHIPDB_MADVISE
 #endif
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
 #include "embed.h"
+#include "log.h"
 #include "nextpnr.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
+namespace {
+std::string chipdb_override;
+std::map<std::string, boost::iostreams::mapped_file_source> chipdb_files;
+
+const void *map_chipdb_file(const std::string &path)
+{
+    auto found = chipdb_files.find(path);
+    if (found == chipdb_files.end()) {
+        if (!boost::filesystem::exists(path))
+            return nullptr;
+        // Read-only mappings are shared, so concurrent processes using the same database share one copy of it in the
+        // page cache; and pages are only read in when they are first touched.
+        auto &file = chipdb_files[path];
+        file.open(path);
+#if defined(CHIPDB_MADVISE)
+        // Most lookups into the database are scattered, so reading ahead of each fault mostly brings in pages that
+        // are never used
+        madvise(const_cast<char *>(file.data()), file.size(), MADV_RANDOM);
+#endif
+        return file.data();
+    }
+    return found->second.data();
+}
+
+// The database given by --chipdb, if any. The file name must match the one the arch asks for, as that is what selects
+// the device; so a database for the wrong device is an error rather than silently being used
+const void *map_chipdb_override(const std::string &filename)
+{
+    std::string expected = boost::filesystem::path(filename).filename().string();
+    if (boost::filesystem::path(chipdb_override).filename().string() != expected)
+        log_error("Chip database '%s' does not match the database '%s' needed for this device.\n",
+                  chipdb_override.c_str(), expected.c_str());
+    const void *ptr = map_chipdb_file(chipdb_override);
+    if (ptr == nullptr)
+        log_error("Chip database '%s' does not exist.\n", chipdb_override.c_str());
+    return ptr;
+}
+} // namespace
+
+void set_chipdb_override(const std::string &path) { chipdb_override = path; }
+
+void log_chipdb_residency()
+{
+#if defined(CHIPDB_MADVISE)
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__)
+    typedef char mincore_t;
+#else
+    typedef unsigned char mincore_t;
+#endif
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    for (auto &file : chipdb_files) {
+        size_t size = file.second.size();
+        std::vector<mincore_t> resident((size + page_size - 1) / page_size);
+        if (mincore(const_cast<char *>(file.second.data()), size, resident.data()) != 0)
+            continue;
+        size_t count = 0;
+        for (auto page : resident)
+            count += (page & 1);
+        log_info("Chip database '%s': %zu of %zu pages resident (%.1f%%)\n", file.first.c_str(), count,
+                 resident.size(), resident.empty() ? 0.0 : (100.0 * count) / resident.size());
+    }
+#endif
+}
+
 #if defined(EXTERNAL_CHIPDB_ROOT)
 
 const void *get_chipdb(const std::string &filename)
 {
-    static std::map<std::string, boost::iostreams::mapped_file> files;
-    if (!files.count(filename)) {
-        std::string full_filename = EXTERNAL_CHIPDB_ROOT "/" + filename;
-        if (boost::filesystem::exists(full_filename))
-            files[filename].open(full_filename, boost::iostreams::mapped_file::priv);
-    }
-    if (files.count(filename))
-        return files.at(filename).data();
-    return nullptr;
+    if (!chipdb_override.empty())
+        return map_chipdb_override(filename);
+    return map_chipdb_file(EXTERNAL_CHIPDB_ROOT "/" + filename);
 }
 
 #elif defined(WIN32)
 
 const void *get_chipdb(const std::string &filename)
 {
+    if (!chipdb_override.empty())
+        return map_chipdb_override(filename);
     HRSRC rc = ::FindResource(nullptr, filename.c_str(), RT_RCDATA);
     HGLOBAL rcData = ::LoadResource(nullptr, rc);
     return ::LockResource(rcData);
@@ -38,6 +103,8 @@ EmbeddedFile *EmbeddedFile::head = nullptr;
 
 const void *get_chipdb(const std::string &filename)
 {
+    if (!chipdb_override.empty())
+        return map_chipdb_override(filename);
     for (EmbeddedFile *file = EmbeddedFile::head; file; file = file->next)
         if (file->filename == filename)
             return file->content;
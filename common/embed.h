@@ -44,6 +44,12 @@ struct EmbeddedFile
 
 const void *get_chipdb(const std::string &filename);
 
+// Load the chip database from this file, instead of the built-in or installed one. Its file name must match the
+// database the arch asks for
+void set_chipdb_override(const std::string &path);
+// Report how many pages of each chip database mapped from a file have been read into memory
+void log_chipdb_residency();
+
 NEXTPNR_NAMESPACE_END
 
 #endif // EMBED_H
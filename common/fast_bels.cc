@@ -0,0 +1,252 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "fast_bels.h"
+
+#include <algorithm>
+#include "thread_pool.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+// Below this many (BEL, type) checks, building is done on the calling thread only
+const size_t min_parallel_checks = 65536;
+
+// Recompute the availability bitmap and free counts of a grid, given the availability of every BEL
+void fill_avail(FastBels::FastBelsData &fb, const std::vector<uint8_t> &bel_avail)
+{
+    fb.avail.assign((fb.bels.size() + 31) / 32, 0);
+    fb.free_count.assign(fb.width * fb.height, 0);
+    fb.total_free = 0;
+    for (int tile = 0; tile < fb.width * fb.height; tile++) {
+        for (int pos = fb.offsets[tile]; pos < fb.offsets[tile + 1]; pos++) {
+            if (!bel_avail[fb.bel_index[pos]])
+                continue;
+            fb.avail[pos / 32] |= (1U << (pos % 32));
+            fb.free_count[tile]++;
+            fb.total_free++;
+        }
+    }
+}
+} // namespace
+
+BelId FastBels::FastBelsData::nthFreeBel(int n) const
+{
+    for (size_t w = 0; w < avail.size(); w++) {
+        uint32_t word = avail[w];
+        int count = Bits::popcount(word);
+        if (n >= count) {
+            n -= count;
+            continue;
+        }
+        for (; n > 0; n--)
+            word &= (word - 1);
+        return bels[w * 32 + Bits::ctz(word)];
+    }
+    return BelId();
+}
+
+void FastBels::initBels()
+{
+    if (!all_bels.empty())
+        return;
+    for (auto bel : ctx->getBels()) {
+        all_bel_index[bel] = int(all_bels.size());
+        all_bels.push_back(bel);
+        all_locs.push_back(ctx->getBelLocation(bel));
+    }
+}
+
+template <typename Tmatch>
+void FastBels::addTypes(size_t count, Tmatch match, std::vector<TypeData *> &type_data,
+                        std::vector<std::unique_ptr<FastBelsData>> &data)
+{
+    initBels();
+    size_t n = all_bels.size();
+    ThreadPool pool((n * count >= min_parallel_checks) ? ThreadPool::default_threads(ctx) : 1);
+
+    // One pass over the BELs, checking each against every new type
+    std::vector<uint8_t> matched(n * count), bel_avail(n);
+    pool.parallel_for(
+            0, n,
+            [&](size_t i) {
+                bel_avail[i] = ctx->checkBelAvail(all_bels[i]);
+                for (size_t t = 0; t < count; t++)
+                    matched[i * count + t] = match(t, all_bels[i]);
+            },
+            1024);
+
+    // Then build the grid for each type from those results; BELs at each location stay in getBels() order
+    pool.parallel_for(
+            0, count,
+            [&](size_t t) {
+                TypeData &td = *type_data.at(t);
+                std::unique_ptr<FastBelsData> fb(new FastBelsData);
+                int possible = 0;
+                for (size_t i = 0; i < n; i++)
+                    possible += matched[i * count + t];
+                td.number_of_possible_bels = possible;
+
+                // Types with only a few BELs are put in a single location, so they can be picked from at random
+                bool single_loc = minBelsForGridPick >= 0 && possible < minBelsForGridPick;
+                auto included = [&](size_t i) {
+                    return matched[i * count + t] && (!check_bel_available || bel_avail[i]);
+                };
+                auto loc_of = [&](size_t i) { return single_loc ? Loc(0, 0, 0) : all_locs[i]; };
+
+                for (size_t i = 0; i < n; i++) {
+                    if (!included(i))
+                        continue;
+                    Loc loc = loc_of(i);
+                    fb->width = std::max(fb->width, loc.x + 1);
+                    fb->height = std::max(fb->height, loc.y + 1);
+                }
+                fb->offsets.assign(fb->width * fb->height + 1, 0);
+                for (size_t i = 0; i < n; i++) {
+                    if (!included(i))
+                        continue;
+                    Loc loc = loc_of(i);
+                    fb->offsets[loc.x * fb->height + loc.y + 1]++;
+                }
+                for (int tile = 0; tile < fb->width * fb->height; tile++)
+                    fb->offsets[tile + 1] += fb->offsets[tile];
+                fb->bels.resize(fb->offsets.back());
+                fb->bel_index.resize(fb->offsets.back());
+                std::vector<int> next(fb->offsets.begin(), fb->offsets.end() - 1);
+                for (size_t i = 0; i < n; i++) {
+                    if (!included(i))
+                        continue;
+                    Loc loc = loc_of(i);
+                    int pos = next[loc.x * fb->height + loc.y]++;
+                    fb->bels[pos] = all_bels[i];
+                    fb->bel_index[pos] = int(i);
+                }
+                fill_avail(*fb, bel_avail);
+                data.at(td.type_index) = std::move(fb);
+            },
+            1);
+
+    bel_refs_valid = false;
+}
+
+void FastBels::addCellTypes(const std::vector<IdString> &types)
+{
+    std::vector<IdString> new_types;
+    std::vector<TypeData *> new_data;
+    for (auto cell_type : types) {
+        if (cell_types.count(cell_type)) {
+            // This cell type has already been added to the fast BEL lookup.
+            continue;
+        }
+        auto &cell_type_data = cell_types[cell_type];
+        cell_type_data.type_index = fast_bels_by_cell_type.size();
+        fast_bels_by_cell_type.emplace_back();
+        new_types.push_back(cell_type);
+        new_data.push_back(&cell_type_data);
+    }
+    if (new_types.empty())
+        return;
+    addTypes(
+            new_types.size(),
+            [&](size_t t, BelId bel) { return ctx->isValidBelForCellType(new_types[t], bel); }, new_data,
+            fast_bels_by_cell_type);
+}
+
+void FastBels::addBelBuckets(const std::vector<BelBucketId> &partitions)
+{
+    std::vector<BelBucketId> new_partitions;
+    std::vector<TypeData *> new_data;
+    for (auto partition : partitions) {
+        if (partition_types.count(partition)) {
+            // This partition has already been added to the fast BEL lookup.
+            continue;
+        }
+        auto &type_data = partition_types[partition];
+        type_data.type_index = fast_bels_by_partition_type.size();
+        fast_bels_by_partition_type.emplace_back();
+        new_partitions.push_back(partition);
+        new_data.push_back(&type_data);
+    }
+    if (new_partitions.empty())
+        return;
+    addTypes(
+            new_partitions.size(),
+            [&](size_t t, BelId bel) { return ctx->getBelBucketForBel(bel) == new_partitions[t]; }, new_data,
+            fast_bels_by_partition_type);
+}
+
+void FastBels::syncAvailability()
+{
+    initBels();
+    size_t n = all_bels.size();
+    ThreadPool pool((n >= min_parallel_checks) ? ThreadPool::default_threads(ctx) : 1);
+    std::vector<uint8_t> bel_avail(n);
+    pool.parallel_for(0, n, [&](size_t i) { bel_avail[i] = ctx->checkBelAvail(all_bels[i]); }, 1024);
+
+    std::vector<FastBelsData *> grids;
+    for (auto &fb : fast_bels_by_cell_type)
+        grids.push_back(fb.get());
+    for (auto &fb : fast_bels_by_partition_type)
+        grids.push_back(fb.get());
+    pool.parallel_for(0, grids.size(), [&](size_t i) { fill_avail(*grids.at(i), bel_avail); }, 1);
+}
+
+void FastBels::buildBelRefs()
+{
+    std::vector<FastBelsData *> grids;
+    for (auto &fb : fast_bels_by_cell_type)
+        grids.push_back(fb.get());
+    for (auto &fb : fast_bels_by_partition_type)
+        grids.push_back(fb.get());
+
+    bel_ref_offsets.assign(all_bels.size() + 1, 0);
+    for (auto fb : grids)
+        for (int idx : fb->bel_index)
+            bel_ref_offsets[idx + 1]++;
+    for (size_t i = 0; i < all_bels.size(); i++)
+        bel_ref_offsets[i + 1] += bel_ref_offsets[i];
+    bel_refs.resize(bel_ref_offsets.back());
+    std::vector<int> next(bel_ref_offsets.begin(), bel_ref_offsets.end() - 1);
+    for (auto fb : grids)
+        for (int pos = 0; pos < int(fb->bel_index.size()); pos++)
+            bel_refs[next[fb->bel_index[pos]]++] = std::make_pair(fb, pos);
+    bel_refs_valid = true;
+}
+
+void FastBels::setBelAvail(BelId bel, bool avail)
+{
+    if (!bel_refs_valid)
+        buildBelRefs();
+    auto found = all_bel_index.find(bel);
+    if (found == all_bel_index.end())
+        return;
+    for (int r = bel_ref_offsets[found->second]; r < bel_ref_offsets[found->second + 1]; r++) {
+        FastBelsData &fb = *bel_refs[r].first;
+        int pos = bel_refs[r].second;
+        if (fb.isAvail(pos) == avail)
+            continue;
+        fb.avail[pos / 32] ^= (1U << (pos % 32));
+        // Find the location holding this position
+        int tile = int(std::upper_bound(fb.offsets.begin(), fb.offsets.end(), pos) - fb.offsets.begin()) - 1;
+        fb.free_count[tile] += avail ? 1 : -1;
+        fb.total_free += avail ? 1 : -1;
+    }
+}
+
+NEXTPNR_NAMESPACE_END
@@ -21,12 +21,20 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include "bits.h"
 #include "nextpnr.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
 // FastBels is a lookup class that provides a fast lookup for finding BELs
 // that support a given cell type.
+//
+// The BELs for each cell type (or bucket) are stored as a flat grid: all the BELs sorted by location, and an offset
+// into that list for each (x, y). It can also track which of those BELs are available, as a bitmap with a count of
+// free BELs per location; so placers can find a free BEL of a type near a location without testing occupied ones.
+// Availability is a snapshot, taken by syncAvailability() and kept up to date by calling setBelAvail() when binding
+// or unbinding BELs.
 struct FastBels
 {
     struct TypeData
@@ -35,114 +43,82 @@ struct FastBels
         int number_of_possible_bels;
     };
 
-    FastBels(Context *ctx, bool check_bel_available, int minBelsForGridPick)
-            : ctx(ctx), check_bel_available(check_bel_available), minBelsForGridPick(minBelsForGridPick)
+    // A contiguous range of BELs at one location
+    struct BelRange
     {
-    }
+        const BelId *b = nullptr, *e = nullptr;
+        const BelId *begin() const { return b; }
+        const BelId *end() const { return e; }
+        size_t size() const { return e - b; }
+        bool empty() const { return b == e; }
+        BelId operator[](size_t i) const { return b[i]; }
+    };
 
-    void addCellType(IdString cell_type)
+    struct FastBelsData
     {
-        auto iter = cell_types.find(cell_type);
-        if (iter != cell_types.end()) {
-            // This cell type has already been added to the fast BEL lookup.
-            return;
-        }
-
-        size_t type_idx = cell_types.size();
-        auto &cell_type_data = cell_types[cell_type];
-        cell_type_data.type_index = type_idx;
-
-        fast_bels_by_cell_type.resize(type_idx + 1);
-        auto &bel_data = fast_bels_by_cell_type.at(type_idx);
-        NPNR_ASSERT(bel_data.get() == nullptr);
-        bel_data = std::make_unique<FastBelsData>();
-
-        for (auto bel : ctx->getBels()) {
-            if (!ctx->isValidBelForCellType(cell_type, bel)) {
-                continue;
+        int width = 0, height = 0;
+        // BELs at (x, y) are bels[offsets[x * height + y]] up to bels[offsets[x * height + y + 1]]
+        std::vector<int> offsets;
+        std::vector<BelId> bels;
+        // Index into FastBels::all_bels for each entry of bels
+        std::vector<int> bel_index;
+
+        // Availability bit for each entry of bels, the number of available BELs at each location and in total
+        std::vector<uint32_t> avail;
+        std::vector<int> free_count;
+        int total_free = 0;
+
+        bool contains(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+
+        BelRange at(int x, int y) const
+        {
+            BelRange range;
+            if (contains(x, y)) {
+                range.b = bels.data() + offsets[x * height + y];
+                range.e = bels.data() + offsets[x * height + y + 1];
             }
-
-            cell_type_data.number_of_possible_bels += 1;
+            return range;
         }
 
-        for (auto bel : ctx->getBels()) {
-            if (check_bel_available && !ctx->checkBelAvail(bel)) {
-                continue;
-            }
-
-            if (!ctx->isValidBelForCellType(cell_type, bel)) {
-                continue;
-            }
-
-            Loc loc = ctx->getBelLocation(bel);
-            if (minBelsForGridPick >= 0 && cell_type_data.number_of_possible_bels < minBelsForGridPick) {
-                loc.x = loc.y = 0;
-            }
+        bool isAvail(int pos) const { return (avail[pos / 32] >> (pos % 32)) & 1; }
 
-            if (int(bel_data->size()) < (loc.x + 1)) {
-                bel_data->resize(loc.x + 1);
-            }
+        int freeCount(int x, int y) const { return contains(x, y) ? free_count[x * height + y] : 0; }
 
-            if (int(bel_data->at(loc.x).size()) < (loc.y + 1)) {
-                bel_data->at(loc.x).resize(loc.y + 1);
-            }
-
-            bel_data->at(loc.x).at(loc.y).push_back(bel);
-        }
-    }
-
-    void addBelBucket(BelBucketId partition)
-    {
-        auto iter = partition_types.find(partition);
-        if (iter != partition_types.end()) {
-            // This partition has already been added to the fast BEL lookup.
-            return;
+        // Call func(bel) for each available BEL at a location, in order
+        template <typename Tfunc> void forEachFreeBel(int x, int y, Tfunc func) const
+        {
+            if (freeCount(x, y) == 0)
+                return;
+            for (int pos = offsets[x * height + y]; pos < offsets[x * height + y + 1]; pos++)
+                if (isAvail(pos))
+                    func(bels[pos]);
         }
 
-        size_t type_idx = partition_types.size();
-        auto &type_data = partition_types[partition];
-        type_data.type_index = type_idx;
-
-        fast_bels_by_partition_type.resize(type_idx + 1);
-        auto &bel_data = fast_bels_by_partition_type.at(type_idx);
-        NPNR_ASSERT(bel_data.get() == nullptr);
-        bel_data = std::make_unique<FastBelsData>();
-
-        for (auto bel : ctx->getBels()) {
-            if (ctx->getBelBucketForBel(bel) != partition) {
-                continue;
-            }
-
-            type_data.number_of_possible_bels += 1;
+        // The first available BEL at a location, or BelId() if there are none
+        BelId firstFreeBel(int x, int y) const
+        {
+            if (freeCount(x, y) > 0)
+                for (int pos = offsets[x * height + y]; pos < offsets[x * height + y + 1]; pos++)
+                    if (isAvail(pos))
+                        return bels[pos];
+            return BelId();
         }
 
-        for (auto bel : ctx->getBels()) {
-            if (check_bel_available && !ctx->checkBelAvail(bel)) {
-                continue;
-            }
-
-            if (ctx->getBelBucketForBel(bel) != partition) {
-                continue;
-            }
-
-            Loc loc = ctx->getBelLocation(bel);
-            if (minBelsForGridPick >= 0 && type_data.number_of_possible_bels < minBelsForGridPick) {
-                loc.x = loc.y = 0;
-            }
-
-            if (int(bel_data->size()) < (loc.x + 1)) {
-                bel_data->resize(loc.x + 1);
-            }
-
-            if (int(bel_data->at(loc.x).size()) < (loc.y + 1)) {
-                bel_data->at(loc.x).resize(loc.y + 1);
-            }
+        // The nth available BEL over the whole grid (in location order), for 0 <= n < total_free
+        BelId nthFreeBel(int n) const;
+    };
 
-            bel_data->at(loc.x).at(loc.y).push_back(bel);
-        }
+    FastBels(Context *ctx, bool check_bel_available, int minBelsForGridPick)
+            : ctx(ctx), check_bel_available(check_bel_available), minBelsForGridPick(minBelsForGridPick)
+    {
     }
 
-    typedef std::vector<std::vector<std::vector<BelId>>> FastBelsData;
+    // Add several cell types or buckets at once, in a single (parallel) pass over the BELs
+    void addCellTypes(const std::vector<IdString> &cell_types);
+    void addBelBuckets(const std::vector<BelBucketId> &partitions);
+
+    void addCellType(IdString cell_type) { addCellTypes({cell_type}); }
+    void addBelBucket(BelBucketId partition) { addBelBuckets({partition}); }
 
     int getBelsForCellType(IdString cell_type, FastBelsData **data)
     {
@@ -174,6 +150,11 @@ struct FastBels
         return type_data.number_of_possible_bels;
     }
 
+    // Take a snapshot of the availability of every BEL in every type added so far
+    void syncAvailability();
+    // Update the availability of a BEL (in every type that includes it) after binding or unbinding it
+    void setBelAvail(BelId bel, bool avail);
+
     Context *ctx;
     const bool check_bel_available;
     const int minBelsForGridPick;
@@ -183,6 +164,23 @@ struct FastBels
 
     std::unordered_map<BelBucketId, TypeData> partition_types;
     std::vector<std::unique_ptr<FastBelsData>> fast_bels_by_partition_type;
+
+  private:
+    // Build the grids for a set of new types, where match(i, bel) says whether bel is in the ith
+    template <typename Tmatch>
+    void addTypes(size_t count, Tmatch match, std::vector<TypeData *> &type_data,
+                  std::vector<std::unique_ptr<FastBelsData>> &data);
+    void initBels();
+    void buildBelRefs();
+
+    // Every BEL in the device, in getBels() order, with its location
+    std::vector<BelId> all_bels;
+    std::vector<Loc> all_locs;
+    std::unordered_map<BelId, int> all_bel_index;
+    // For each BEL (by index in all_bels), the grids and positions it appears at, used by setBelAvail
+    std::vector<int> bel_ref_offsets;
+    std::vector<std::pair<FastBelsData *, int>> bel_refs;
+    bool bel_refs_valid = false;
 };
 
 NEXTPNR_NAMESPACE_END
@@ -41,6 +41,10 @@ struct IdString
 
     void set(const BaseCtx *ctx, const std::string &s);
 
+    // Find the IdString for s without creating it, returning false if there isn't one. Like set(), this is safe to
+    // call from several threads at once
+    static bool lookup(const BaseCtx *ctx, const std::string &s, IdString &result);
+
     IdString(const BaseCtx *ctx, const std::string &s) { set(ctx, s); }
 
     IdString(const BaseCtx *ctx, const char *s) { set(ctx, s); }
@@ -0,0 +1,108 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "idstring_db.h"
+
+#include "nextpnr_assertions.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+#ifndef NPNR_DISABLE_THREADS
+#define SHARD_LOCK(shard) std::lock_guard<std::mutex> shard_lock((shard).mutex)
+#else
+#define SHARD_LOCK(shard)
+#endif
+
+IdStringDb::IdStringDb() : chunks(new std::atomic<Chunk *>[max_chunks]), shards(new Shard[num_shards]), next_idx(0)
+{
+    for (int i = 0; i < max_chunks; i++)
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+}
+
+IdStringDb::~IdStringDb()
+{
+    for (int i = 0; i < max_chunks; i++)
+        delete chunks[i].load(std::memory_order_relaxed);
+}
+
+IdStringDb::Shard &IdStringDb::shard_for(const std::string &s) const
+{
+    // Use the upper bits of the hash, so the choice of shard is independent of the buckets used within it
+    size_t hash = std::hash<std::string>()(s);
+    return shards[(hash >> (sizeof(size_t) * 8 - 6)) % num_shards];
+}
+
+int IdStringDb::add_locked(Shard &shard, const std::string &s)
+{
+    int idx = next_idx.fetch_add(1);
+    int chunk_idx = idx >> chunk_bits;
+    NPNR_ASSERT(chunk_idx < max_chunks);
+    Chunk *chunk = chunks[chunk_idx].load(std::memory_order_acquire);
+    if (chunk == nullptr) {
+        // Another thread, adding a string to a different shard, might be creating the same chunk
+        Chunk *new_chunk = new Chunk;
+        if (chunks[chunk_idx].compare_exchange_strong(chunk, new_chunk, std::memory_order_acq_rel)) {
+            chunk = new_chunk;
+        } else {
+            delete new_chunk;
+        }
+    }
+    std::string &stored = chunk->strs[idx & (chunk_size - 1)];
+    stored = s;
+    shard.str_to_idx.emplace(&stored, idx);
+    return idx;
+}
+
+int IdStringDb::get_or_add(const std::string &s)
+{
+    Shard &shard = shard_for(s);
+    SHARD_LOCK(shard);
+    auto found = shard.str_to_idx.find(&s);
+    if (found != shard.str_to_idx.end())
+        return found->second;
+    return add_locked(shard, s);
+}
+
+int IdStringDb::lookup(const std::string &s) const
+{
+    Shard &shard = shard_for(s);
+    SHARD_LOCK(shard);
+    auto found = shard.str_to_idx.find(&s);
+    return (found != shard.str_to_idx.end()) ? found->second : -1;
+}
+
+void IdStringDb::add_at(const std::string &s, int idx)
+{
+    Shard &shard = shard_for(s);
+    SHARD_LOCK(shard);
+    NPNR_ASSERT(shard.str_to_idx.count(&s) == 0);
+    NPNR_ASSERT(next_idx.load() == idx);
+    add_locked(shard, s);
+}
+
+const std::string &IdStringDb::str(int idx) const
+{
+    NPNR_ASSERT(idx >= 0 && idx < next_idx.load(std::memory_order_relaxed));
+    Chunk *chunk = chunks[idx >> chunk_bits].load(std::memory_order_acquire);
+    return chunk->strs[idx & (chunk_size - 1)];
+}
+
+#undef SHARD_LOCK
+
+NEXTPNR_NAMESPACE_END
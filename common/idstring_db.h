@@ -0,0 +1,103 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef IDSTRING_DB_H
+#define IDSTRING_DB_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#ifndef NPNR_DISABLE_THREADS
+#include <mutex>
+#endif
+
+#include "nextpnr_namespaces.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// The string table behind IdString, which may be used by several threads at once.
+//
+// Strings are stored in fixed-size chunks that are never moved or freed until the table is destroyed, so looking up
+// the string for an index never takes a lock. The string to index map is split into shards by hash, each with its own
+// lock, so threads creating different names rarely wait for each other.
+//
+// Indices are handed out in creation order; so if several threads create new names at once, the order of the
+// resulting IdStrings (and anything sorted by them) depends on scheduling.
+class IdStringDb
+{
+  public:
+    IdStringDb();
+    ~IdStringDb();
+
+    IdStringDb(const IdStringDb &) = delete;
+    IdStringDb &operator=(const IdStringDb &) = delete;
+
+    // Get the index of a string, adding it if it isn't already present
+    int get_or_add(const std::string &s);
+    // Get the index of a string, or -1 if it isn't present
+    int lookup(const std::string &s) const;
+    // Add a string which must not already be present, with an index that must be the next one to be handed out
+    void add_at(const std::string &s, int idx);
+
+    const std::string &str(int idx) const;
+    // Number of strings in the table
+    int size() const { return next_idx.load(); }
+
+  private:
+    static const int chunk_bits = 12;
+    static const int chunk_size = 1 << chunk_bits;
+    static const int max_chunks = 1 << 16;
+    static const int num_shards = 64;
+
+    struct Chunk
+    {
+        std::string strs[chunk_size];
+    };
+
+    struct StrPtrHash
+    {
+        size_t operator()(const std::string *s) const noexcept { return std::hash<std::string>()(*s); }
+    };
+    struct StrPtrEqual
+    {
+        bool operator()(const std::string *a, const std::string *b) const { return *a == *b; }
+    };
+
+    struct Shard
+    {
+#ifndef NPNR_DISABLE_THREADS
+        mutable std::mutex mutex;
+#endif
+        // Keys point into the chunk storage
+        std::unordered_map<const std::string *, int, StrPtrHash, StrPtrEqual> str_to_idx;
+    };
+
+    Shard &shard_for(const std::string &s) const;
+    // Store a string at a new index; called with the shard for the string locked
+    int add_locked(Shard &shard, const std::string &s);
+
+    std::unique_ptr<std::atomic<Chunk *>[]> chunks;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<int> next_idx;
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif /* IDSTRING_DB_H */
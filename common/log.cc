@@ -25,6 +25,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
+#if !defined(WIN32)
+#include <sys/resource.h>
+#endif
 
 #include "log.h"
 
@@ -195,4 +198,21 @@ void log_flush()
         f.first->flush();
 }
 
+size_t get_peak_rss()
+{
+#if defined(WIN32)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return size_t(usage.ru_maxrss);
+#else
+    // Linux and the BSDs report kilobytes
+    return size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
 NEXTPNR_NAMESPACE_END
@@ -71,6 +71,9 @@ void log_nonfatal_error(const char *format, ...) NPNR_ATTRIBUTE(format(printf, 1
 void log_break();
 void log_flush();
 
+// Peak resident set size of the process in bytes, or 0 if this isn't known on the current platform
+size_t get_peak_rss();
+
 static inline void log_assert_worker(bool cond, const char *expr, const char *file, int line)
 {
     if (!cond)
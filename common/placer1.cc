@@ -23,6 +23,7 @@
 
 #include "placer1.h"
 #include <algorithm>
+#include <atomic>
 #include <boost/lexical_cast.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 #include <chrono>
@@ -31,6 +32,7 @@
 #include <limits>
 #include <list>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <queue>
 #include <set>
@@ -43,6 +45,7 @@
 #include "log.h"
 #include "place_common.h"
 #include "scope_lock.h"
+#include "thread_pool.h"
 #include "timing.h"
 #include "util.h"
 
@@ -93,18 +96,18 @@ class SAPlacer
             cell_types_in_use.insert(cell_type);
         }
 
-        for (auto cell_type : cell_types_in_use) {
-            fast_bels.addCellType(cell_type);
-        }
+        fast_bels.addCellTypes(std::vector<IdString>(cell_types_in_use.begin(), cell_types_in_use.end()));
 
         net_bounds.resize(ctx->nets.size());
         net_arc_tcost.resize(ctx->nets.size());
+        net_arc_crit.resize(ctx->nets.size());
         old_udata.reserve(ctx->nets.size());
         net_by_udata.reserve(ctx->nets.size());
         decltype(NetInfo::udata) n = 0;
         for (auto &net : ctx->nets) {
             old_udata.emplace_back(net.second->udata);
             net_arc_tcost.at(n).resize(net.second->users.size());
+            net_arc_crit.at(n).resize(net.second->users.size(), -1);
             net.second->udata = n++;
             net_by_udata.push_back(net.second.get());
         }
@@ -132,6 +135,23 @@ class SAPlacer
             region_bounds[r->name] = bb;
         }
         build_port_index();
+        serial_moves.rng = ctx;
+        serial_moves.mc = &moveChange;
+        if (cfg.parallel) {
+            bool any_local = false;
+            for (auto bel : ctx->getBels()) {
+                if (ctx->isBelBindLocal(bel)) {
+                    any_local = true;
+                    break;
+                }
+            }
+            if (cfg.netShareWeight > 0)
+                log_warning("Parallel SA placement is not supported with net sharing; running serially.\n");
+            else if (!any_local)
+                log_warning("Parallel SA placement is not supported by this architecture; running serially.\n");
+            else
+                pool.reset(new ThreadPool(ThreadPool::default_threads(ctx)));
+        }
     }
 
     ~SAPlacer()
@@ -204,6 +224,7 @@ class SAPlacer
             auto iplace_start = std::chrono::high_resolution_clock::now();
             // Place cells randomly initially
             log_info("Creating initial placement for remaining %d cells.\n", int(autoplaced.size()));
+            fast_bels.syncAvailability();
 
             for (auto cell : autoplaced) {
                 place_initial(cell);
@@ -246,10 +267,13 @@ class SAPlacer
             tmg.setup();
 
         // Calculate costs after initial placement
-        setup_costs();
+        setup_costs(/*full=*/true);
         moveChange.init(this);
-        curr_wirelen_cost = total_wirelen_cost();
-        curr_timing_cost = total_timing_cost();
+        if (pool) {
+            thread_changes.resize(pool->size());
+            for (auto &tc : thread_changes)
+                tc.init(this);
+        }
         last_wirelen_cost = curr_wirelen_cost;
         last_timing_cost = curr_timing_cost;
 
@@ -273,10 +297,13 @@ class SAPlacer
                          iter, temp, double(curr_timing_cost), double(curr_wirelen_cost));
 
             for (int m = 0; m < 15; ++m) {
-                // Loop through all automatically placed cells
-                for (auto cell : autoplaced) {
+                // Loop through all automatically placed cells; when running in parallel, those that can be moved
+                // within their tile are tried first and the rest left for the serial loop
+                if (pool)
+                    parallel_sweep(autoplaced, serial_cells);
+                for (auto cell : pool ? serial_cells : autoplaced) {
                     // Find another random Bel for this cell
-                    BelId try_bel = random_bel_for_cell(cell);
+                    BelId try_bel = random_bel_for_cell(*ctx, cell);
                     // If valid, try and swap to a new position and see if
                     // the new position is valid/worthwhile
                     if (try_bel != BelId() && try_bel != cell->bel)
@@ -285,7 +312,7 @@ class SAPlacer
                 // Also try swapping chains, if applicable
                 for (auto cb : chain_basis) {
                     Loc chain_base_loc = ctx->getBelLocation(cb->bel);
-                    BelId try_base = random_bel_for_cell(cb, chain_base_loc.z);
+                    BelId try_base = random_bel_for_cell(*ctx, cb, chain_base_loc.z);
                     if (try_base != BelId() && try_base != cb->bel)
                         try_swap_chain(cb, try_base);
                 }
@@ -307,6 +334,7 @@ class SAPlacer
                     NPNR_ASSERT(incr.ny0 == gold.ny0);
                     NPNR_ASSERT(incr.ny1 == gold.ny1);
                 }
+                NPNR_ASSERT(curr_wirelen_cost == total_wirelen_cost());
             }
 
             if (curr_wirelen_cost < min_wirelen) {
@@ -353,8 +381,10 @@ class SAPlacer
             }
             // Once cooled below legalise threshold, run legalisation and start requiring
             // legal moves only
+            bool legalised = false;
             if (diameter < legalise_dia && require_legal) {
                 if (legalise_relative_constraints(ctx)) {
+                    legalised = true;
                     // Only increase temperature if something was moved
                     autoplaced.clear();
                     chain_basis.clear();
@@ -379,18 +409,19 @@ class SAPlacer
             }
 
             // Invoke timing analysis to obtain criticalities
-            if (!cfg.budgetBased && cfg.timing_driven)
-                tmg.run();
-            // Need to rebuild costs after criticalities change
-            setup_costs();
+            if (!cfg.budgetBased && cfg.timing_driven) {
+                if (legalised)
+                    tmg.run();
+                else
+                    tmg.run_incremental();
+            }
+            // Need to rebuild costs after criticalities change; the bounding boxes are kept up to date by each move,
+            // so only need recomputing if legalisation moved cells
+            setup_costs(/*full=*/legalised);
             // Reset incremental bounds
             moveChange.reset(this);
             moveChange.new_net_bounds = net_bounds;
 
-            // Recalculate total metric entirely to avoid rounding errors
-            // accumulating over time
-            curr_wirelen_cost = total_wirelen_cost();
-            curr_timing_cost = total_timing_cost();
             last_wirelen_cost = curr_wirelen_cost;
             last_timing_cost = curr_timing_cost;
             // Let the UI show visualization updates.
@@ -441,10 +472,28 @@ class SAPlacer
             CellInfo *ripup_target = nullptr;
             BelId ripup_bel = BelId();
             if (cell->bel != BelId()) {
-                ctx->unbindBel(cell->bel);
+                BelId old_bel = cell->bel;
+                ctx->unbindBel(old_bel);
+                fast_bels.setBelAvail(old_bel, ctx->checkBelAvail(old_bel));
             }
             IdString targetType = cell->type;
 
+            if (cell->region == nullptr || !cell->region->constr_bels) {
+                // Pick a random free bel from the availability bitmap; only if there are none does the whole device
+                // need to be scanned for a cell to rip up
+                FastBels::FastBelsData *bel_data;
+                fast_bels.getBelsForCellType(targetType, &bel_data);
+                while (bel_data->total_free > 0) {
+                    BelId bel = bel_data->nthFreeBel(ctx->rng(bel_data->total_free));
+                    if (ctx->checkBelAvail(bel)) {
+                        best_bel = bel;
+                        break;
+                    }
+                    // Bel was made unavailable by something other than initial placement
+                    fast_bels.setBelAvail(bel, false);
+                }
+            }
+
             auto proc_bel = [&](BelId bel) {
                 if (ctx->isValidBelForCellType(targetType, bel)) {
                     if (ctx->checkBelAvail(bel)) {
@@ -465,13 +514,15 @@ class SAPlacer
                 }
             };
 
-            if (cell->region != nullptr && cell->region->constr_bels) {
-                for (auto bel : cell->region->bels) {
-                    proc_bel(bel);
-                }
-            } else {
-                for (auto bel : ctx->getBels()) {
-                    proc_bel(bel);
+            if (best_bel == BelId()) {
+                if (cell->region != nullptr && cell->region->constr_bels) {
+                    for (auto bel : cell->region->bels) {
+                        proc_bel(bel);
+                    }
+                } else {
+                    for (auto bel : ctx->getBels()) {
+                        proc_bel(bel);
+                    }
                 }
             }
 
@@ -492,9 +543,11 @@ class SAPlacer
                 if (ripup_target != nullptr) {
                     ctx->bindBel(best_bel, ripup_target, STRENGTH_WEAK);
                 }
+                fast_bels.setBelAvail(best_bel, ctx->checkBelAvail(best_bel));
                 all_placed = false;
                 continue;
             }
+            fast_bels.setBelAvail(best_bel, false);
 
             // Back annotate location
             cell->attrs[ctx->id("BEL")] = ctx->getBelName(cell->bel).str(ctx);
@@ -502,10 +555,22 @@ class SAPlacer
         }
     }
 
+    struct MoveThread;
+
     // Attempt a SA position swap, return true on success or false on failure
     bool try_swap_position(CellInfo *cell, BelId newBel)
+    {
+        bool accepted = try_swap_position(cell, newBel, serial_moves);
+        finish_moves(serial_moves);
+        return accepted;
+    }
+
+    // Attempt a SA position swap, using the given state for random numbers and cost changes and accumulating the
+    // results in it
+    bool try_swap_position(CellInfo *cell, BelId newBel, MoveThread &mt)
     {
         static const double epsilon = 1e-20;
+        MoveChangeData &moveChange = *mt.mc;
         moveChange.reset(this);
         if (!require_legal && cell->isConstrained(false))
             return false;
@@ -572,10 +637,10 @@ class SAPlacer
         delta += (cfg.constraintWeight / temp) * (new_dist - old_dist) / last_wirelen_cost;
         if (cfg.netShareWeight > 0)
             delta += -cfg.netShareWeight * (net_delta_score / std::max<double>(total_net_share, epsilon));
-        n_move++;
+        mt.n_move++;
         // SA acceptance criteria
-        if (delta < 0 || (temp > 1e-8 && (ctx->rng() / float(0x3fffffff)) <= std::exp(-delta / temp))) {
-            n_accept++;
+        if (delta < 0 || (temp > 1e-8 && (mt.rng->rng() / float(0x3fffffff)) <= std::exp(-delta / temp))) {
+            mt.n_accept++;
         } else {
             if (other_cell != nullptr)
                 ctx->unbindBel(oldBel);
@@ -583,6 +648,13 @@ class SAPlacer
             goto swap_fail;
         }
         commit_cost_changes(moveChange);
+        mt.wirelen_delta += moveChange.wirelen_delta;
+        mt.timing_delta += moveChange.timing_delta;
+        if (cfg.timing_driven && !cfg.budgetBased) {
+            mt.dirty_cells.push_back(cell);
+            if (other_cell != nullptr)
+                mt.dirty_cells.push_back(other_cell);
+        }
 #if 0
         log_info("swap %s -> %s\n", cell->name.c_str(ctx), ctx->nameOfBel(newBel));
         if (other_cell != nullptr)
@@ -715,6 +787,16 @@ class SAPlacer
             goto swap_fail;
         }
         commit_cost_changes(moveChange);
+        curr_wirelen_cost += moveChange.wirelen_delta;
+        curr_timing_cost += moveChange.timing_delta;
+        if (cfg.timing_driven && !cfg.budgetBased) {
+            for (const auto &mm : moves_made) {
+                tmg.set_cell_dirty(mm.first);
+                CellInfo *bound = ctx->getBoundBelCell(mm.second);
+                if (bound != nullptr)
+                    tmg.set_cell_dirty(bound);
+            }
+        }
         return true;
     swap_fail:
         for (const auto &entry : boost::adaptors::reverse(moves_made))
@@ -724,7 +806,7 @@ class SAPlacer
 
     // Find a random Bel of the correct type for a cell, within the specified
     // diameter
-    BelId random_bel_for_cell(CellInfo *cell, int force_z = -1)
+    BelId random_bel_for_cell(DeterministicRNG &rng, CellInfo *cell, int force_z = -1)
     {
         IdString targetType = cell->type;
         Loc curr_loc = ctx->getBelLocation(cell->bel);
@@ -732,33 +814,28 @@ class SAPlacer
 
         int dx = diameter, dy = diameter;
         if (cell->region != nullptr && cell->region->constr_bels) {
-            dx = std::min(cfg.hpwl_scale_x * diameter,
-                          (region_bounds[cell->region->name].x1 - region_bounds[cell->region->name].x0) + 1);
-            dy = std::min(cfg.hpwl_scale_y * diameter,
-                          (region_bounds[cell->region->name].y1 - region_bounds[cell->region->name].y0) + 1);
+            const BoundingBox &rb = region_bounds.at(cell->region->name);
+            dx = std::min(cfg.hpwl_scale_x * diameter, (rb.x1 - rb.x0) + 1);
+            dy = std::min(cfg.hpwl_scale_y * diameter, (rb.y1 - rb.y0) + 1);
             // Clamp location to within bounds
-            curr_loc.x = std::max(region_bounds[cell->region->name].x0, curr_loc.x);
-            curr_loc.x = std::min(region_bounds[cell->region->name].x1, curr_loc.x);
-            curr_loc.y = std::max(region_bounds[cell->region->name].y0, curr_loc.y);
-            curr_loc.y = std::min(region_bounds[cell->region->name].y1, curr_loc.y);
+            curr_loc.x = std::max(rb.x0, curr_loc.x);
+            curr_loc.x = std::min(rb.x1, curr_loc.x);
+            curr_loc.y = std::max(rb.y0, curr_loc.y);
+            curr_loc.y = std::min(rb.y1, curr_loc.y);
         }
 
         FastBels::FastBelsData *bel_data;
         auto type_cnt = fast_bels.getBelsForCellType(targetType, &bel_data);
 
         while (true) {
-            int nx = ctx->rng(2 * dx + 1) + std::max(curr_loc.x - dx, 0);
-            int ny = ctx->rng(2 * dy + 1) + std::max(curr_loc.y - dy, 0);
+            int nx = rng.rng(2 * dx + 1) + std::max(curr_loc.x - dx, 0);
+            int ny = rng.rng(2 * dy + 1) + std::max(curr_loc.y - dy, 0);
             if (cfg.minBelsForGridPick >= 0 && type_cnt < cfg.minBelsForGridPick)
                 nx = ny = 0;
-            if (nx >= int(bel_data->size()))
-                continue;
-            if (ny >= int(bel_data->at(nx).size()))
-                continue;
-            const auto &fb = bel_data->at(nx).at(ny);
-            if (fb.size() == 0)
+            const auto fb = bel_data->at(nx, ny);
+            if (fb.empty())
                 continue;
-            BelId bel = fb.at(ctx->rng(int(fb.size())));
+            BelId bel = fb[rng.rng(int(fb.size()))];
             if (force_z != -1) {
                 Loc loc = ctx->getBelLocation(bel);
                 if (loc.z != force_z)
@@ -829,6 +906,12 @@ class SAPlacer
 
     // Get the timing cost for an arc of a net
     inline double get_timing_cost(NetInfo *net, size_t user)
+    {
+        return get_timing_cost(net, user, cfg.budgetBased ? 0 : tmg.get_criticality(CellPortKey(net->users.at(user))));
+    }
+
+    // Get the timing cost for an arc of a net, given the criticality of its sink (unused if budget based)
+    inline double get_timing_cost(NetInfo *net, size_t user, float crit)
     {
         int cc;
         if (net->driver.cell == nullptr)
@@ -839,23 +922,41 @@ class SAPlacer
             double delay = ctx->getDelayNS(ctx->predictDelay(net, net->users.at(user)));
             return std::min(10.0, std::exp(delay - ctx->getDelayNS(net->users.at(user).budget) / 10));
         } else {
-            float crit = tmg.get_criticality(CellPortKey(net->users.at(user)));
             double delay = ctx->getDelayNS(ctx->predictDelay(net, net->users.at(user)));
             return delay * std::pow(crit, crit_exp);
         }
     }
 
-    // Set up the cost maps
-    void setup_costs()
+    // Set up the cost maps, and recalculate the total costs entirely to avoid rounding errors accumulating over time.
+    // Moves keep the net bounds and arc costs up to date, so unless full is set only the arcs whose criticality
+    // has changed since they were last costed are recomputed.
+    void setup_costs(bool full)
     {
-        for (auto net : sorted(ctx->nets)) {
-            NetInfo *ni = net.second;
+        curr_wirelen_cost = 0;
+        curr_timing_cost = 0;
+        for (auto ni : net_by_udata) {
             if (ignore_net(ni))
                 continue;
-            net_bounds[ni->udata] = get_net_bounds(ni);
-            if (cfg.timing_driven && int(ni->users.size()) < cfg.timingFanoutThresh)
-                for (size_t i = 0; i < ni->users.size(); i++)
-                    net_arc_tcost[ni->udata][i] = get_timing_cost(ni, i);
+            if (full)
+                net_bounds[ni->udata] = get_net_bounds(ni);
+            curr_wirelen_cost += net_bounds[ni->udata].hpwl(cfg);
+            if (cfg.timing_driven && int(ni->users.size()) < cfg.timingFanoutThresh) {
+                auto &arc_tcost = net_arc_tcost[ni->udata];
+                auto &arc_crit = net_arc_crit[ni->udata];
+                for (size_t i = 0; i < ni->users.size(); i++) {
+                    if (cfg.budgetBased) {
+                        // Budgets may have been redistributed, so always recompute
+                        arc_tcost[i] = get_timing_cost(ni, i, 0);
+                    } else {
+                        float crit = tmg.get_criticality(CellPortKey(ni->users.at(i)));
+                        if (full || crit != arc_crit[i]) {
+                            arc_tcost[i] = get_timing_cost(ni, i, crit);
+                            arc_crit[i] = crit;
+                        }
+                    }
+                    curr_timing_cost += arc_tcost[i];
+                }
+            }
         }
     }
 
@@ -868,18 +969,6 @@ class SAPlacer
         return cost;
     }
 
-    // Get the total timing cost for the design
-    double total_timing_cost()
-    {
-        double cost = 0;
-        for (const auto &net : net_arc_tcost) {
-            for (auto arc_cost : net) {
-                cost += arc_cost;
-            }
-        }
-        return cost;
-    }
-
     // Cost-change-related data for a move
     struct MoveChangeData
     {
@@ -937,6 +1026,18 @@ class SAPlacer
 
     } moveChange;
 
+    // State for a sequence of moves made by one thread; with the number of moves, and the changes to the cost, to be
+    // added to the placer totals once they are done
+    struct MoveThread
+    {
+        DeterministicRNG *rng = nullptr;
+        MoveChangeData *mc = nullptr;
+        int n_move = 0, n_accept = 0;
+        wirelen_t wirelen_delta = 0;
+        double timing_delta = 0;
+        std::vector<CellInfo *> dirty_cells;
+    } serial_moves;
+
     void add_move_cell(MoveChangeData &mc, CellInfo *cell, BelId old_bel)
     {
         Loc curr_loc = ctx->getBelLocation(cell->bel);
@@ -949,6 +1050,11 @@ class SAPlacer
             if (ignore_net(pn))
                 continue;
             BoundingBox &curr_bounds = mc.new_net_bounds[pn->udata];
+            // If this move hasn't touched the net yet, start from its committed bounds; which might have been changed
+            // by moves made using another MoveChangeData
+            if (mc.already_bounds_changed_x[pn->udata] == MoveChangeData::NO_CHANGE &&
+                mc.already_bounds_changed_y[pn->udata] == MoveChangeData::NO_CHANGE)
+                curr_bounds = net_bounds[pn->udata];
             // Incremental bounding box updates
             // Note that everything other than full updates are applied immediately rather than being queued,
             // so further updates to the same net in the same move are dealt with correctly.
@@ -1129,8 +1235,118 @@ class SAPlacer
             net_bounds[bc] = md.new_net_bounds[bc];
         for (const auto &tc : md.new_arc_costs)
             net_arc_tcost[tc.first.first].at(tc.first.second) = tc.second;
-        curr_wirelen_cost += md.wirelen_delta;
-        curr_timing_cost += md.timing_delta;
+    }
+
+    // Add the moves made using some per-thread state to the overall placer state, and reset it
+    void finish_moves(MoveThread &mt)
+    {
+        n_move += mt.n_move;
+        n_accept += mt.n_accept;
+        curr_wirelen_cost += mt.wirelen_delta;
+        curr_timing_cost += mt.timing_delta;
+        for (auto cell : mt.dirty_cells)
+            tmg.set_cell_dirty(cell);
+        mt.n_move = mt.n_accept = 0;
+        mt.wirelen_delta = 0;
+        mt.timing_delta = 0;
+        mt.dirty_cells.clear();
+    }
+
+    // Try moving cells in parallel. The device is split into square tiles, offset by a random amount each sweep so
+    // that cells can cross tile boundaries over time. A cell is only moved in parallel if all of its nets are within
+    // its tile, and then only to a bel within the same tile (swapping with a cell that meets the same conditions); so
+    // the thread handling a tile is the only one to touch its bels, and the cells and nets on them. Both bels must be
+    // ones the arch binds without touching state outside their grid location (isBelBindLocal). Each tile has its
+    // own random number generator, seeded from the main one, and its results are added to the totals in a fixed
+    // order so placement is deterministic. The cells that can't be moved in parallel are returned in serial_cells, in
+    // their original order.
+    void parallel_sweep(const std::vector<CellInfo *> &cells, std::vector<CellInfo *> &serial_out)
+    {
+        int tile_size = std::max(8, (std::max(max_x, max_y) + 1) / 4);
+        int offset_x = ctx->rng(tile_size), offset_y = ctx->rng(tile_size);
+        int tiles_x = (max_x + offset_x) / tile_size + 1, tiles_y = (max_y + offset_y) / tile_size + 1;
+        auto tile_at = [&](int x, int y) {
+            return ((y + offset_y) / tile_size) * tiles_x + ((x + offset_x) / tile_size);
+        };
+
+        std::vector<int> net_tile(net_bounds.size(), -1);
+        for (size_t i = 0; i < net_bounds.size(); i++) {
+            auto &bb = net_bounds.at(i);
+            int t0 = tile_at(bb.x0, bb.y0);
+            if (t0 == tile_at(bb.x1, bb.y1))
+                net_tile.at(i) = t0;
+        }
+
+        std::vector<std::vector<CellInfo *>> tile_cells(tiles_x * tiles_y);
+        std::unordered_map<CellInfo *, int> cell_tile;
+        serial_out.clear();
+        for (auto cell : cells) {
+            Loc loc = ctx->getBelLocation(cell->bel);
+            int tile = tile_at(loc.x, loc.y);
+            bool movable = !cell->isConstrained(false) && ctx->isBelBindLocal(cell->bel);
+            for (const auto &port : cell->ports) {
+                NetInfo *pn = port.second.net;
+                if (!movable || pn == nullptr)
+                    continue;
+                // Nets that are ignored for cost purposes can span tiles, but their driver mustn't move as the
+                // check for global buffers depends on its location
+                if (ignore_net(pn))
+                    movable = (pn->driver.cell != cell);
+                else
+                    movable = (net_tile.at(pn->udata) == tile);
+            }
+            if (movable) {
+                tile_cells.at(tile).push_back(cell);
+                cell_tile[cell] = tile;
+            } else {
+                serial_out.push_back(cell);
+            }
+        }
+
+        std::vector<DeterministicRNG> tile_rng(tile_cells.size());
+        std::vector<MoveThread> tile_moves(tile_cells.size());
+        uint64_t seed = ctx->rng64();
+        for (size_t i = 0; i < tile_rng.size(); i++) {
+            tile_rng.at(i).rngseed(seed + (i + 1) * 0x9E3779B97F4A7C15ULL);
+            tile_moves.at(i).rng = &tile_rng.at(i);
+        }
+
+        std::atomic<size_t> next_tile(0);
+        ctx->belUiReloadDeferred = true;
+        try {
+            pool->run_on_all([&](int thread) {
+                while (true) {
+                    size_t tile = next_tile.fetch_add(1);
+                    if (tile >= tile_cells.size())
+                        break;
+                    MoveThread &mt = tile_moves.at(tile);
+                    mt.mc = &thread_changes.at(thread);
+                    for (auto cell : tile_cells.at(tile)) {
+                        BelId try_bel = random_bel_for_cell(*mt.rng, cell);
+                        if (try_bel == BelId() || try_bel == cell->bel)
+                            continue;
+                        Loc loc = ctx->getBelLocation(try_bel);
+                        if (tile_at(loc.x, loc.y) != int(tile) || !ctx->isBelBindLocal(try_bel))
+                            continue;
+                        CellInfo *other_cell = ctx->getBoundBelCell(try_bel);
+                        if (other_cell != nullptr) {
+                            auto fnd = cell_tile.find(other_cell);
+                            if (fnd == cell_tile.end() || fnd->second != int(tile))
+                                continue;
+                        }
+                        try_swap_position(cell, try_bel, mt);
+                    }
+                }
+            });
+        } catch (...) {
+            ctx->belUiReloadDeferred = false;
+            throw;
+        }
+        ctx->belUiReloadDeferred = false;
+        ctx->refreshUi();
+
+        for (auto &mt : tile_moves)
+            finish_moves(mt);
     }
     // Build the cell port -> user index
     void build_port_index()
@@ -1209,6 +1425,8 @@ class SAPlacer
     std::vector<BoundingBox> net_bounds;
     // Map net arcs to their timing cost (criticality * delay ns)
     std::vector<std::vector<double>> net_arc_tcost;
+    // Map net arcs to the criticality their timing cost was last computed with
+    std::vector<std::vector<float>> net_arc_crit;
 
     // Fast lookup for cell port to net user index
     std::unordered_map<const PortInfo *, size_t> fast_port_to_user;
@@ -1229,6 +1447,11 @@ class SAPlacer
     FastBels fast_bels;
     std::unordered_set<BelId> locked_bels;
     std::vector<NetInfo *> net_by_udata;
+    // Threads for parallel sweeps, if enabled; and the cost change data for each thread
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<MoveChangeData> thread_changes;
+    // Cells that couldn't be moved in the last parallel sweep
+    std::vector<CellInfo *> serial_cells;
     std::vector<decltype(NetInfo::udata)> old_udata;
     bool require_legal = true;
     const int legalise_dia = 4;
@@ -1247,6 +1470,7 @@ Placer1Cfg::Placer1Cfg(Context *ctx)
     timingFanoutThresh = std::numeric_limits<int>::max();
     timing_driven = ctx->setting<bool>("timing_driven");
     slack_redist_iter = ctx->setting<int>("slack_redist_iter");
+    parallel = ctx->setting<bool>("placer1/parallel", false);
     hpwl_scale_x = 1;
     hpwl_scale_y = 1;
 }
@@ -34,6 +34,9 @@ struct Placer1Cfg
     int timingFanoutThresh;
     bool timing_driven;
     int slack_redist_iter;
+    // Move cells within disjoint tiles of the device in parallel; requires the arch to support binding bels in
+    // different tiles concurrently
+    bool parallel;
     int hpwl_scale_x, hpwl_scale_y;
 };
 
@@ -50,6 +50,7 @@
 #include "place_common.h"
 #include "placer1.h"
 #include "scope_lock.h"
+#include "thread_pool.h"
 #include "timing.h"
 #include "util.h"
 
@@ -61,70 +62,54 @@ namespace {
 // solves it, and the representation that requires
 template <typename T> struct EquationSystem
 {
-
-    EquationSystem(size_t rows, size_t cols)
+    // Coefficients are collected, unsummed, into one or more buffers and only added up when the system is solved.
+    // This allows the equations to be built in parallel, each thread writing to its own buffers; as the buffers are
+    // summed in a fixed order the result doesn't depend on which thread filled which buffer
+    struct Buffer
     {
-        A.resize(cols);
-        rhs.resize(rows);
-    }
+        std::vector<std::tuple<int, int, T>> coeffs; // (row, col, value) in the order they were added
+        std::vector<std::pair<int, T>> rhs;          // (row, value)
 
-    // Simple sparse format, easy to convert to CCS for solver
-    std::vector<std::vector<std::pair<int, T>>> A; // col -> (row, x[row, col]) sorted by row
-    std::vector<T> rhs;                            // RHS vector
-    void reset()
-    {
-        for (auto &col : A)
-            col.clear();
-        std::fill(rhs.begin(), rhs.end(), T());
-    }
+        void add_coeff(int row, int col, T val) { coeffs.emplace_back(row, col, val); }
+        void add_rhs(int row, T val) { rhs.emplace_back(row, val); }
+    };
 
-    void add_coeff(int row, int col, T val)
+    size_t rows = 0, cols = 0;
+    std::vector<Buffer> buffers;
+
+    // Clear all coefficients, and resize the system; keeping the storage of the buffers and the matrix
+    void reset(size_t new_rows, size_t new_cols, size_t num_buffers = 1)
     {
-        auto &Ac = A.at(col);
-        // Binary search
-        int b = 0, e = int(Ac.size()) - 1;
-        while (b <= e) {
-            int i = (b + e) / 2;
-            if (Ac.at(i).first == row) {
-                Ac.at(i).second += val;
-                return;
-            }
-            if (Ac.at(i).first > row)
-                e = i - 1;
-            else
-                b = i + 1;
+        rows = new_rows;
+        cols = new_cols;
+        buffers.resize(std::max<size_t>(1, num_buffers));
+        for (auto &buf : buffers) {
+            buf.coeffs.clear();
+            buf.rhs.clear();
         }
-        Ac.insert(Ac.begin() + b, std::make_pair(row, val));
     }
 
-    void add_rhs(int row, T val) { rhs[row] += val; }
+    // Coefficients added directly go after those in all the buffers
+    void add_coeff(int row, int col, T val) { buffers.back().add_coeff(row, col, val); }
+    void add_rhs(int row, T val) { buffers.back().add_rhs(row, val); }
 
     void solve(std::vector<T> &x, float tolerance)
     {
         using namespace Eigen;
         if (x.empty())
             return;
-        NPNR_ASSERT(x.size() == A.size());
-
-        VectorXd vx(x.size()), vb(rhs.size());
-        SparseMatrix<T> mat(A.size(), A.size());
-
-        std::vector<int> colnnz;
-        for (auto &Ac : A)
-            colnnz.push_back(int(Ac.size()));
-        mat.reserve(colnnz);
-        for (int col = 0; col < int(A.size()); col++) {
-            auto &Ac = A.at(col);
-            for (auto &el : Ac)
-                mat.insert(el.first, col) = el.second;
-        }
+        NPNR_ASSERT(x.size() == cols);
 
+        compress();
+        VectorXd vx(x.size()), vb(rows);
         for (int i = 0; i < int(x.size()); i++)
             vx[i] = x.at(i);
-        for (int i = 0; i < int(rhs.size()); i++)
+        for (int i = 0; i < int(rows); i++)
             vb[i] = rhs.at(i);
 
-        ConjugateGradient<SparseMatrix<T>, Lower | Upper> solver;
+        // A row-major matrix and using both triangles allows Eigen to run the matrix-vector products of CG in
+        // parallel, when built with OpenMP
+        ConjugateGradient<SparseMatrix<T, RowMajor>, Lower | Upper> solver;
         solver.setTolerance(tolerance);
         VectorXd xr = solver.compute(mat).solveWithGuess(vb, vx);
         for (int i = 0; i < int(x.size()); i++)
@@ -132,6 +117,69 @@ template <typename T> struct EquationSystem
         // for (int i = 0; i < int(x.size()); i++)
         //    log_info("x[%d] = %f\n", i, x.at(i));
     }
+
+  private:
+    Eigen::SparseMatrix<T, Eigen::RowMajor> mat;
+    std::vector<T> rhs;
+    std::vector<int> row_start, entry_fill;
+    std::vector<std::pair<int, T>> entries;
+    std::vector<int> outer, inner;
+    std::vector<T> values;
+
+    // Sum the buffered coefficients into compressed row form, and load them into mat. Coefficients for the same entry
+    // are added in the order they were added to the buffers. The sparsity pattern of the equations usually changes
+    // little between iterations, so the matrix storage is only rebuilt if it actually changed
+    void compress()
+    {
+        row_start.assign(rows + 1, 0);
+        for (auto &buf : buffers)
+            for (auto &c : buf.coeffs)
+                ++row_start.at(std::get<0>(c) + 1);
+        for (size_t i = 0; i < rows; i++)
+            row_start[i + 1] += row_start[i];
+        entries.resize(row_start.back());
+        entry_fill.assign(row_start.begin(), row_start.end() - 1);
+        for (auto &buf : buffers)
+            for (auto &c : buf.coeffs)
+                entries[entry_fill[std::get<0>(c)]++] = std::make_pair(std::get<1>(c), std::get<2>(c));
+
+        outer.clear();
+        inner.clear();
+        values.clear();
+        outer.push_back(0);
+        for (size_t row = 0; row < rows; row++) {
+            auto begin = entries.begin() + row_start[row], end = entries.begin() + row_start[row + 1];
+            std::stable_sort(begin, end, [](const std::pair<int, T> &a, const std::pair<int, T> &b) {
+                return a.first < b.first;
+            });
+            for (auto it = begin; it != end; ++it) {
+                if (int(inner.size()) > outer.back() && inner.back() == it->first) {
+                    values.back() += it->second;
+                } else {
+                    inner.push_back(it->first);
+                    values.push_back(it->second);
+                }
+            }
+            outer.push_back(int(inner.size()));
+        }
+
+        rhs.assign(rows, T());
+        for (auto &buf : buffers)
+            for (auto &r : buf.rhs)
+                rhs.at(r.first) += r.second;
+
+        bool same_pattern = size_t(mat.rows()) == rows && size_t(mat.cols()) == cols && mat.isCompressed() &&
+                            size_t(mat.nonZeros()) == inner.size() &&
+                            std::equal(outer.begin(), outer.end(), mat.outerIndexPtr()) &&
+                            std::equal(inner.begin(), inner.end(), mat.innerIndexPtr());
+        if (!same_pattern) {
+            mat.resize(rows, cols);
+            mat.resizeNonZeros(inner.size());
+            std::copy(outer.begin(), outer.end(), mat.outerIndexPtr());
+            std::copy(inner.begin(), inner.end(), mat.innerIndexPtr());
+        }
+        std::copy(values.begin(), values.end(), mat.valuePtr());
+    }
 };
 
 } // namespace
@@ -143,6 +191,14 @@ class HeAPPlacer
             : ctx(ctx), cfg(cfg), fast_bels(ctx, /*check_bel_available=*/true, -1), tmg(ctx)
     {
         Eigen::initParallel();
+        // The X and Y axes are solved concurrently, so split the threads between them
+        int axis_threads = std::max(1, ThreadPool::default_threads(ctx) / 2);
+        for (auto &pool : axis_pool)
+            pool.reset(new ThreadPool(axis_threads));
+        Eigen::setNbThreads(axis_threads);
+        legalise_pool.reset(new ThreadPool(ThreadPool::default_threads(ctx)));
+        for (auto &net : sorted(ctx->nets))
+            solve_nets.push_back(net.second);
         tmg.setup_only = true;
         tmg.setup();
     }
@@ -386,6 +442,15 @@ class HeAPPlacer
     // cells of a certain type)
     std::vector<CellInfo *> solve_cells;
 
+    // All nets, in the order their equations are built
+    std::vector<NetInfo *> solve_nets;
+    // Threads used to build the equations, and the equation systems themselves, for each axis. These are kept
+    // between iterations to reuse their storage
+    std::unique_ptr<ThreadPool> axis_pool[2];
+    // Threads used to legalise cells in parallel
+    std::unique_ptr<ThreadPool> legalise_pool;
+    EquationSystem<double> axis_es[2];
+
     // For cells in a chain, this is the ultimate root cell of the chain (sometimes this is not constr_parent
     // where chains are within chains
     std::unordered_map<IdString, CellInfo *> chain_root;
@@ -459,12 +524,8 @@ class HeAPPlacer
             buckets_in_use.insert(bucket);
         }
 
-        for (auto cell_type : cell_types_in_use) {
-            fast_bels.addCellType(cell_type);
-        }
-        for (auto bucket : buckets_in_use) {
-            fast_bels.addBelBucket(bucket);
-        }
+        fast_bels.addCellTypes(std::vector<IdString>(cell_types_in_use.begin(), cell_types_in_use.end()));
+        fast_bels.addBelBuckets(std::vector<BelBucketId>(buckets_in_use.begin(), buckets_in_use.end()));
 
         // Determine bounding boxes of region constraints
         for (auto &region : sorted(ctx->region)) {
@@ -495,10 +556,10 @@ class HeAPPlacer
     // Build and solve in one direction
     void build_solve_direction(bool yaxis, int iter)
     {
+        auto &es = axis_es[yaxis ? 1 : 0];
         for (int i = 0; i < 5; i++) {
-            EquationSystem<double> esx(solve_cells.size(), solve_cells.size());
-            build_equations(esx, yaxis, iter);
-            solve_equations(esx, yaxis);
+            build_equations(es, yaxis, iter);
+            solve_equations(es, yaxis);
         }
     }
 
@@ -675,6 +736,78 @@ class HeAPPlacer
             func(net->users.at(i), i);
     }
 
+    // Stamp the equations for the arcs of one net into an equation buffer
+    void build_net_equations(EquationSystem<double>::Buffer &buf, NetInfo *ni, bool yaxis)
+    {
+        auto cell_pos = [&](CellInfo *cell) { return yaxis ? cell_locs.at(cell->name).y : cell_locs.at(cell->name).x; };
+        if (ni->driver.cell == nullptr)
+            return;
+        if (ni->users.empty())
+            return;
+        if (cell_locs.at(ni->driver.cell->name).global)
+            return;
+        // Find the bounds of the net in this axis, and the ports that correspond to these bounds
+        PortRef *lbport = nullptr, *ubport = nullptr;
+        int lbpos = std::numeric_limits<int>::max(), ubpos = std::numeric_limits<int>::min();
+        foreach_port(ni, [&](PortRef &port, int user_idx) {
+            int pos = cell_pos(port.cell);
+            if (pos < lbpos) {
+                lbpos = pos;
+                lbport = &port;
+            }
+            if (pos > ubpos) {
+                ubpos = pos;
+                ubport = &port;
+            }
+        });
+        NPNR_ASSERT(lbport != nullptr);
+        NPNR_ASSERT(ubport != nullptr);
+
+        auto stamp_equation = [&](PortRef &var, PortRef &eqn, double weight) {
+            if (eqn.cell->udata == dont_solve)
+                return;
+            int row = eqn.cell->udata;
+            int v_pos = cell_pos(var.cell);
+            if (var.cell->udata != dont_solve) {
+                buf.add_coeff(row, var.cell->udata, weight);
+            } else {
+                buf.add_rhs(row, -v_pos * weight);
+            }
+            if (cell_offsets.count(var.cell->name)) {
+                buf.add_rhs(row, -(yaxis ? cell_offsets.at(var.cell->name).second
+                                         : cell_offsets.at(var.cell->name).first) *
+                                         weight);
+            }
+        };
+
+        // Add all relevant connections to the matrix
+        foreach_port(ni, [&](PortRef &port, int user_idx) {
+            int this_pos = cell_pos(port.cell);
+            auto process_arc = [&](PortRef *other) {
+                if (other == &port)
+                    return;
+                int o_pos = cell_pos(other->cell);
+                double weight = 1.0 / (ni->users.size() *
+                                       std::max<double>(1, (yaxis ? cfg.hpwl_scale_y : cfg.hpwl_scale_x) *
+                                                                   std::abs(o_pos - this_pos)));
+
+                if (user_idx != -1) {
+                    weight *= (1.0 + cfg.timingWeight * std::pow(tmg.get_criticality(CellPortKey(port)),
+                                                                 cfg.criticalityExponent));
+                }
+
+                // If cell 0 is not fixed, it will stamp +w on its equation and -w on the other end's equation,
+                // if the other end isn't fixed
+                stamp_equation(port, port, weight);
+                stamp_equation(port, *other, -weight);
+                stamp_equation(*other, *other, weight);
+                stamp_equation(*other, port, -weight);
+            };
+            process_arc(lbport);
+            process_arc(ubport);
+        });
+    }
+
     // Build the system of equations for either X or Y
     void build_equations(EquationSystem<double> &es, bool yaxis, int iter = -1)
     {
@@ -684,77 +817,19 @@ class HeAPPlacer
             return yaxis ? cell_locs.at(cell->name).legal_y : cell_locs.at(cell->name).legal_x;
         };
 
-        es.reset();
-
-        for (auto net : sorted(ctx->nets)) {
-            NetInfo *ni = net.second;
-            if (ni->driver.cell == nullptr)
-                continue;
-            if (ni->users.empty())
-                continue;
-            if (cell_locs.at(ni->driver.cell->name).global)
-                continue;
-            // Find the bounds of the net in this axis, and the ports that correspond to these bounds
-            PortRef *lbport = nullptr, *ubport = nullptr;
-            int lbpos = std::numeric_limits<int>::max(), ubpos = std::numeric_limits<int>::min();
-            foreach_port(ni, [&](PortRef &port, int user_idx) {
-                int pos = cell_pos(port.cell);
-                if (pos < lbpos) {
-                    lbpos = pos;
-                    lbport = &port;
-                }
-                if (pos > ubpos) {
-                    ubpos = pos;
-                    ubport = &port;
-                }
-            });
-            NPNR_ASSERT(lbport != nullptr);
-            NPNR_ASSERT(ubport != nullptr);
-
-            auto stamp_equation = [&](PortRef &var, PortRef &eqn, double weight) {
-                if (eqn.cell->udata == dont_solve)
-                    return;
-                int row = eqn.cell->udata;
-                int v_pos = cell_pos(var.cell);
-                if (var.cell->udata != dont_solve) {
-                    es.add_coeff(row, var.cell->udata, weight);
-                } else {
-                    es.add_rhs(row, -v_pos * weight);
-                }
-                if (cell_offsets.count(var.cell->name)) {
-                    es.add_rhs(row, -(yaxis ? cell_offsets.at(var.cell->name).second
-                                            : cell_offsets.at(var.cell->name).first) *
-                                            weight);
-                }
-            };
+        // Nets are split into fixed size chunks, each stamped into its own buffer, so that the equations are the same
+        // regardless of the number of threads
+        const size_t chunk_size = 256;
+        size_t num_chunks = (solve_nets.size() + chunk_size - 1) / chunk_size;
+        es.reset(solve_cells.size(), solve_cells.size(), num_chunks);
 
-            // Add all relevant connections to the matrix
-            foreach_port(ni, [&](PortRef &port, int user_idx) {
-                int this_pos = cell_pos(port.cell);
-                auto process_arc = [&](PortRef *other) {
-                    if (other == &port)
-                        return;
-                    int o_pos = cell_pos(other->cell);
-                    double weight = 1.0 / (ni->users.size() *
-                                           std::max<double>(1, (yaxis ? cfg.hpwl_scale_y : cfg.hpwl_scale_x) *
-                                                                       std::abs(o_pos - this_pos)));
-
-                    if (user_idx != -1) {
-                        weight *= (1.0 + cfg.timingWeight * std::pow(tmg.get_criticality(CellPortKey(port)),
-                                                                     cfg.criticalityExponent));
-                    }
+        auto build_chunk = [&](size_t chunk) {
+            auto &buf = es.buffers.at(chunk);
+            for (size_t i = chunk * chunk_size; i < std::min(solve_nets.size(), (chunk + 1) * chunk_size); i++)
+                build_net_equations(buf, solve_nets.at(i), yaxis);
+        };
+        axis_pool[yaxis ? 1 : 0]->parallel_for(0, num_chunks, build_chunk, 1);
 
-                    // If cell 0 is not fixed, it will stamp +w on its equation and -w on the other end's equation,
-                    // if the other end isn't fixed
-                    stamp_equation(port, port, weight);
-                    stamp_equation(port, *other, -weight);
-                    stamp_equation(*other, *other, weight);
-                    stamp_equation(*other, port, -weight);
-                };
-                process_arc(lbport);
-                process_arc(ubport);
-            });
-        }
         if (iter != -1) {
             float alpha = cfg.alpha;
             for (size_t row = 0; row < solve_cells.size(); row++) {
@@ -832,12 +907,31 @@ class HeAPPlacer
                 ctx->unbindBel(ci->bel);
         }
 
-        // At the moment we don't follow the full HeAP algorithm using cuts for legalisation, instead using
-        // the simple greedy largest-macro-first approach.
+        // Macros, and cells with region or absolute placement constraints, are placed first using a simple greedy
+        // largest-macro-first approach. The remaining cells are then legalised using the HeAP recursive cut
+        // algorithm, leaving any that couldn't be placed to the greedy legaliser again.
         std::priority_queue<std::pair<int, IdString>> remaining;
+        std::vector<CellInfo *> cut_cells;
         for (auto cell : solve_cells) {
-            remaining.emplace(chain_size[cell->name], cell->name);
+            if (cfg.parallelLegalise && cell->constr_children.empty() && !cell->constr_abs_z && cell->region == nullptr)
+                cut_cells.push_back(cell);
+            else
+                remaining.emplace(chain_size[cell->name], cell->name);
         }
+        legalise_greedy(remaining, require_validity);
+        if (!cut_cells.empty()) {
+            for (auto cell : legalise_cuts(cut_cells, require_validity))
+                remaining.emplace(chain_size[cell->name], cell->name);
+            legalise_greedy(remaining, require_validity);
+        }
+        auto endt = std::chrono::high_resolution_clock::now();
+        sl_time += std::chrono::duration<float>(endt - startt).count();
+    }
+
+    // Greedily legalise cells in order of macro size, randomly probing bels with an increasing radius around their
+    // solver location and ripping up other cells if needed
+    void legalise_greedy(std::priority_queue<std::pair<int, IdString>> &remaining, bool require_validity)
+    {
         int ripup_radius = 2;
         int total_iters = 0;
         int total_iters_noreset = 0;
@@ -906,13 +1000,13 @@ class HeAPPlacer
                         // checking (e.g. BRAM and DSP will not be in all cols/rows), so we don't waste effort
                         for (int x = std::max(0, cell_locs.at(ci->name).x - radius);
                              x <= std::min(max_x, cell_locs.at(ci->name).x + radius); x++) {
-                            if (x >= int(fb->size()))
+                            if (x >= fb->width)
                                 break;
                             for (int y = std::max(0, cell_locs.at(ci->name).y - radius);
                                  y <= std::min(max_y, cell_locs.at(ci->name).y + radius); y++) {
-                                if (y >= int(fb->at(x).size()))
+                                if (y >= fb->height)
                                     break;
-                                if (fb->at(x).at(y).size() > 0)
+                                if (!fb->at(x, y).empty())
                                     goto notempty;
                             }
                         }
@@ -929,11 +1023,7 @@ class HeAPPlacer
                 if (ny < 0 || ny > max_y)
                     continue;
 
-                if (nx >= int(fb->size()))
-                    continue;
-                if (ny >= int(fb->at(nx).size()))
-                    continue;
-                if (fb->at(nx).at(ny).empty())
+                if (fb->at(nx, ny).empty())
                     continue;
 
                 // The number of attempts to find a location to try
@@ -957,7 +1047,7 @@ class HeAPPlacer
 
                 if (ci->constr_children.empty() && !ci->constr_abs_z) {
                     // The case where we have no relative constraints
-                    for (auto sz : fb->at(nx).at(ny)) {
+                    for (auto sz : fb->at(nx, ny)) {
                         // Look through all bels in this tile; checking region constraint if applicable
                         if (!ci->testRegion(sz))
                             continue;
@@ -984,21 +1074,9 @@ class HeAPPlacer
                                 ctx->unbindBel(sz);
                                 if (bound != nullptr)
                                     ctx->bindBel(sz, bound, STRENGTH_WEAK);
-                                int input_len = 0;
                                 // Compute a fast input wirelength metric at this bel; and save if better than our last
                                 // try
-                                for (auto &port : ci->ports) {
-                                    auto &p = port.second;
-                                    if (p.type != PORT_IN || p.net == nullptr || p.net->driver.cell == nullptr)
-                                        continue;
-                                    CellInfo *drv = p.net->driver.cell;
-                                    auto drv_loc = cell_locs.find(drv->name);
-                                    if (drv_loc == cell_locs.end())
-                                        continue;
-                                    if (drv_loc->second.global)
-                                        continue;
-                                    input_len += std::abs(drv_loc->second.x - nx) + std::abs(drv_loc->second.y - ny);
-                                }
+                                int input_len = get_input_len(ci, nx, ny);
                                 if (input_len < best_inp_len) {
                                     best_inp_len = input_len;
                                     bestBel = sz;
@@ -1018,7 +1096,7 @@ class HeAPPlacer
                     }
                 } else {
                     // We do have relative constraints
-                    for (auto sz : fb->at(nx).at(ny)) {
+                    for (auto sz : fb->at(nx, ny)) {
                         Loc loc = ctx->getBelLocation(sz);
                         // Check that the absolute-z constraint is satisfied if applicable
                         if (ci->constr_abs_z && loc.z != ci->constr_z)
@@ -1101,9 +1179,251 @@ class HeAPPlacer
                 }
             }
         }
-        auto endt = std::chrono::high_resolution_clock::now();
-        sl_time += std::chrono::duration<float>(endt - startt).count();
     }
+
+    // Sum of the distances from the drivers of a cell's inputs to a location
+    int get_input_len(CellInfo *ci, int x, int y)
+    {
+        int input_len = 0;
+        for (auto &port : ci->ports) {
+            auto &p = port.second;
+            if (p.type != PORT_IN || p.net == nullptr || p.net->driver.cell == nullptr)
+                continue;
+            CellInfo *drv = p.net->driver.cell;
+            auto drv_loc = cell_locs.find(drv->name);
+            if (drv_loc == cell_locs.end())
+                continue;
+            if (drv_loc->second.global)
+                continue;
+            input_len += std::abs(drv_loc->second.x - x) + std::abs(drv_loc->second.y - y);
+        }
+        return input_len;
+    }
+
+    // Cells without placement constraints are legalised by splitting them into independent regions, which are processed
+    // in parallel. A region's cells may only be placed on its own free bels, and the regions being processed at any one
+    // time never share free bels, so nothing needs to be locked.
+    struct LegaliseRegion
+    {
+        int x0, y0, x1, y1;
+        // The set of bels the region's cells are placed on, as an index into the free bel grids being used
+        int group;
+        std::vector<int> cells; // indices into the list of cells being legalised
+    };
+    struct LegaliseRegionResult
+    {
+        // Regions to process at the next level, if this one was split
+        std::vector<LegaliseRegion> children;
+        std::vector<std::pair<CellInfo *, BelId>> placed;
+        std::vector<CellInfo *> failed;
+    };
+
+    // Process a level of regions at a time, in parallel, until there are none left. process(region, result) either
+    // chooses bels for a region's cells, or splits it into child regions that form part of the next level. The chosen
+    // bels and the cells that couldn't be placed are appended to placed and failed in region order, so they don't
+    // depend on the number of threads. Nothing in the context may be modified while processing a region
+    template <typename Tfunc>
+    void legalise_regions(std::vector<LegaliseRegion> level, Tfunc process,
+                          std::vector<std::pair<CellInfo *, BelId>> &placed, std::vector<CellInfo *> &failed)
+    {
+        std::vector<LegaliseRegionResult> results;
+        std::vector<LegaliseRegion> next;
+        while (!level.empty()) {
+            results.clear();
+            results.resize(level.size());
+            legalise_pool->parallel_for(
+                    0, level.size(), [&](size_t i) { process(level.at(i), results.at(i)); }, 1);
+            next.clear();
+            for (auto &res : results) {
+                std::move(res.children.begin(), res.children.end(), std::back_inserter(next));
+                placed.insert(placed.end(), res.placed.begin(), res.placed.end());
+                failed.insert(failed.end(), res.failed.begin(), res.failed.end());
+            }
+            std::swap(level, next);
+        }
+    }
+
+    // Bind the bels chosen by legalise_regions, in order. Cells whose bel turns out to be unavailable or (if
+    // require_validity is set) invalid are added to failed, to be placed by the greedy legaliser
+    void bind_legalised(const std::vector<std::pair<CellInfo *, BelId>> &placed, std::vector<CellInfo *> &failed,
+                        bool require_validity)
+    {
+        for (auto &cell_bel : placed) {
+            CellInfo *ci = cell_bel.first;
+            BelId bel = cell_bel.second;
+            if (!ctx->checkBelAvail(bel)) {
+                failed.push_back(ci);
+                continue;
+            }
+            ctx->bindBel(bel, ci, STRENGTH_WEAK);
+            if (require_validity && !ctx->isBelLocationValid(bel)) {
+                ctx->unbindBel(bel);
+                failed.push_back(ci);
+                continue;
+            }
+            Loc loc = ctx->getBelLocation(bel);
+            cell_locs[ci->name].x = loc.x;
+            cell_locs[ci->name].y = loc.y;
+        }
+    }
+
+    // Legalise cells without placement constraints using recursive cuts, as in the HeAP paper. Each region is cut in
+    // two across its longer side, at the point that splits its free bels evenly. Its cells, sorted by their spread
+    // location, are divided between the two halves so that neither has more cells than free bels, keeping as many
+    // cells as possible on the side they are already on. Cutting stops once a region is a single tile, whose cells
+    // then take its free bels in turn; so as long as there are enough bels overall every cell gets a legal location
+    // by construction.
+    //
+    // Cells are partitioned by bel bucket rather than by cell type, so that cell types which share bels (such as LUTs
+    // of different sizes) are cut together and never choose the same bel. A bucket's bels may not all suit every cell
+    // type in it; cells only take bels valid for their type, and any left without one go to the greedy legaliser.
+    //
+    // The regions at each level of cuts are processed in parallel by legalise_regions. Returns the cells that couldn't
+    // be placed, or whose placement turned out not to be valid.
+    std::vector<CellInfo *> legalise_cuts(const std::vector<CellInfo *> &cells, bool require_validity)
+    {
+        // The bels in each bucket, with a snapshot of which are free
+        std::unordered_map<BelBucketId, int> bucket_index;
+        std::vector<FastBels::FastBelsData *> free_bels;
+        std::vector<LegaliseRegion> level;
+        // The spread location of each cell
+        std::vector<std::pair<double, double>> raw_pos;
+        for (int i = 0; i < int(cells.size()); i++) {
+            CellInfo *ci = cells.at(i);
+            raw_pos.emplace_back(cell_locs.at(ci->name).rawx, cell_locs.at(ci->name).rawy);
+            BelBucketId bucket = ctx->getBelBucketForCellType(ci->type);
+            if (!bucket_index.count(bucket)) {
+                bucket_index[bucket] = int(free_bels.size());
+                FastBels::FastBelsData *fb;
+                fast_bels.getBelsForBelBucket(bucket, &fb);
+                free_bels.push_back(fb);
+                level.push_back(LegaliseRegion{0, 0, max_x, max_y, bucket_index.at(bucket), {}});
+            }
+            level.at(bucket_index.at(bucket)).cells.push_back(i);
+        }
+        fast_bels.syncAvailability();
+
+        auto cut_or_place = [&](LegaliseRegion &r, LegaliseRegionResult &res) {
+            const FastBels::FastBelsData *fbt = free_bels.at(r.group);
+            // Free bels in each column and row of the region, used to trim empty edges and find the cut
+            std::vector<int> col_free(r.x1 - r.x0 + 1, 0), row_free(r.y1 - r.y0 + 1, 0);
+            int total_free = 0;
+            for (int x = r.x0; x <= r.x1; x++)
+                for (int y = r.y0; y <= r.y1; y++) {
+                    int n = fbt->freeCount(x, y);
+                    col_free.at(x - r.x0) += n;
+                    row_free.at(y - r.y0) += n;
+                    total_free += n;
+                }
+            if (total_free == 0) {
+                for (int i : r.cells)
+                    res.failed.push_back(cells.at(i));
+                return;
+            }
+            int x0 = r.x0, x1 = r.x1, y0 = r.y0, y1 = r.y1;
+            while (col_free.at(x0 - r.x0) == 0)
+                x0++;
+            while (col_free.at(x1 - r.x0) == 0)
+                x1--;
+            while (row_free.at(y0 - r.y0) == 0)
+                y0++;
+            while (row_free.at(y1 - r.y0) == 0)
+                y1--;
+
+            if (r.cells.size() == 1) {
+                // No need to cut any further, just take the free bel closest to the cell that suits its type
+                CellInfo *ci = cells.at(r.cells.front());
+                auto &loc = raw_pos.at(r.cells.front());
+                BelId best_bel;
+                double best_dist = std::numeric_limits<double>::max();
+                for (int x = x0; x <= x1; x++)
+                    for (int y = y0; y <= y1; y++) {
+                        double dist = std::abs(x - loc.first) + std::abs(y - loc.second);
+                        if (dist >= best_dist)
+                            continue;
+                        fbt->forEachFreeBel(x, y, [&](BelId bel) {
+                            if (dist < best_dist && ctx->isValidBelForCellType(ci->type, bel)) {
+                                best_dist = dist;
+                                best_bel = bel;
+                            }
+                        });
+                    }
+                if (best_bel == BelId())
+                    res.failed.push_back(ci);
+                else
+                    res.placed.emplace_back(ci, best_bel);
+                return;
+            }
+
+            if (x0 == x1 && y0 == y1) {
+                std::vector<BelId> bels;
+                fbt->forEachFreeBel(x0, y0, [&](BelId bel) { bels.push_back(bel); });
+                // Give each cell the first unused bel that suits it, placing the cells that suit the fewest bels
+                // first
+                std::vector<std::pair<int, int>> cell_choices;
+                for (int i : r.cells) {
+                    IdString type = cells.at(i)->type;
+                    int n = int(std::count_if(bels.begin(), bels.end(),
+                                              [&](BelId bel) { return ctx->isValidBelForCellType(type, bel); }));
+                    cell_choices.emplace_back(n, i);
+                }
+                std::stable_sort(cell_choices.begin(), cell_choices.end(),
+                                 [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+                                     return a.first < b.first;
+                                 });
+                std::vector<bool> used(bels.size(), false);
+                for (auto &choice : cell_choices) {
+                    CellInfo *ci = cells.at(choice.second);
+                    size_t j = 0;
+                    while (j < bels.size() && (used.at(j) || !ctx->isValidBelForCellType(ci->type, bels.at(j))))
+                        j++;
+                    if (j < bels.size()) {
+                        used.at(j) = true;
+                        res.placed.emplace_back(ci, bels.at(j));
+                    } else {
+                        res.failed.push_back(ci);
+                    }
+                }
+                return;
+            }
+
+            bool dir = (y1 - y0) > (x1 - x0);
+            int lo = dir ? y0 : x0, hi = dir ? y1 : x1;
+            auto &line_free = dir ? row_free : col_free;
+            int line_base = dir ? r.y0 : r.x0;
+            // Cut after the line where half the free bels are on either side (leaving at least one line for the right)
+            int cut = lo, left_free = 0;
+            for (int i = lo; i < hi; i++) {
+                cut = i;
+                left_free += line_free.at(i - line_base);
+                if (2 * left_free >= total_free)
+                    break;
+            }
+            int right_free = total_free - left_free;
+
+            auto pos = [&](int i) { return dir ? raw_pos.at(i).second : raw_pos.at(i).first; };
+            std::stable_sort(r.cells.begin(), r.cells.end(), [&](int a, int b) { return pos(a) < pos(b); });
+            int n = int(r.cells.size());
+            int natural = int(std::count_if(r.cells.begin(), r.cells.end(), [&](int i) { return pos(i) < cut + 1; }));
+            int n_left = std::min(std::min(left_free, n), std::max(natural, n - right_free));
+
+            LegaliseRegion left{x0, y0, dir ? x1 : cut, dir ? cut : y1, r.group, {}};
+            LegaliseRegion right{dir ? x0 : cut + 1, dir ? cut + 1 : y0, x1, y1, r.group, {}};
+            left.cells.assign(r.cells.begin(), r.cells.begin() + n_left);
+            right.cells.assign(r.cells.begin() + n_left, r.cells.end());
+            if (!left.cells.empty())
+                res.children.push_back(std::move(left));
+            if (!right.cells.empty())
+                res.children.push_back(std::move(right));
+        };
+
+        std::vector<std::pair<CellInfo *, BelId>> placed;
+        std::vector<CellInfo *> failed;
+        legalise_regions(std::move(level), cut_or_place, placed, failed);
+        bind_legalised(placed, failed, require_validity);
+        return failed;
+    }
+
     // Implementation of the cut-based spreading as described in the HeAP/SimPL papers
 
     template <typename T> T limit_to_reg(Region *reg, T val, bool dir)
@@ -1242,7 +1562,7 @@ class HeAPPlacer
         std::vector<std::vector<ChainExtent>> chaines;
         std::map<IdString, ChainExtent> cell_extents;
 
-        std::vector<std::vector<std::vector<std::vector<BelId>>> *> fb;
+        std::vector<FastBels::FastBelsData *> fb;
 
         std::vector<SpreaderRegion> regions;
         std::unordered_set<int> merged_regions;
@@ -1253,9 +1573,7 @@ class HeAPPlacer
 
         int bels_at(int x, int y, int type)
         {
-            if (x >= int(fb.at(type)->size()) || y >= int(fb.at(type)->at(x).size()))
-                return 0;
-            return int(fb.at(type)->at(x).at(y).size());
+            return int(fb.at(type)->at(x, y).size());
         }
 
         bool is_cell_fixed(const CellInfo &cell) const
@@ -1830,6 +2148,7 @@ PlacerHeapCfg::PlacerHeapCfg(Context *ctx)
     timing_driven = ctx->setting<bool>("timing_driven");
     solverTolerance = 1e-5;
     placeAllAtOnce = false;
+    parallelLegalise = ctx->setting<bool>("placerHeap/parallelLegalise", true);
 
     hpwl_scale_x = 1;
     hpwl_scale_y = 1;
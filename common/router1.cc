@@ -21,6 +21,7 @@
 #include <cmath>
 #include <queue>
 
+#include "dary_heap.h"
 #include "log.h"
 #include "router1.h"
 #include "scope_lock.h"
@@ -112,7 +113,7 @@ struct Router1
     std::unordered_set<arc_key, arc_key::Hash> queued_arcs;
 
     std::unordered_map<WireId, QueuedWire> visited;
-    std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> queue;
+    DAryHeap<QueuedWire, QueuedWire::Greater> queue;
 
     std::unordered_map<WireId, int> wireScores;
     std::unordered_map<NetInfo *, int> netScores;
@@ -502,10 +503,7 @@ struct Router1
 
         // reset wire queue
 
-        if (!queue.empty()) {
-            std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> new_queue;
-            queue.swap(new_queue);
-        }
+        queue.clear();
         visited.clear();
 
         // A* main loop
@@ -29,17 +29,23 @@
 #include "router2.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <boost/algorithm/string.hpp>
 #include <boost/container/flat_map.hpp>
 #include <chrono>
 #include <deque>
 #include <fstream>
 #include <queue>
 
+#include "dary_heap.h"
 #include "hash_table.h"
+#include "json_frontend.h"
 #include "log.h"
 #include "nextpnr.h"
 #include "router1.h"
 #include "scope_lock.h"
+#include "thread_pool.h"
 #include "timing.h"
 #include "util.h"
 
@@ -68,6 +74,8 @@ struct Router2
         int cx, cy, hpwl;
         int total_route_us = 0;
         float max_crit = 0;
+        // Rerouted since routing was last bound, so route delays in the timing analyser are stale
+        bool tmg_dirty = false;
     };
 
     struct WireScore
@@ -78,34 +86,110 @@ struct Router2
         float total() const { return cost + togo_cost; }
     };
 
-    struct PerWireData
+    // Nets bound to a wire, mapping net --> (number of arcs; driving pip). Almost all wires are used by at most one
+    // net, so the first is stored inline and only congested wires allocate an overflow map for the others
+    struct BoundNets
     {
-        // nextpnr
-        WireId w;
-        // net --> number of arcs; driving pip
-        boost::container::flat_map<int, std::pair<int, PipId>> bound_nets;
-        // Historical congestion cost
-        float hist_cong_cost = 1.0;
-        // Wire is unavailable as locked to another arc
-        bool unavailable = false;
-        // This wire has to be used for this net
-        int reserved_net = -1;
-        // The notional location of the wire, to guarantee thread safety
-        int16_t x = 0, y = 0;
-        // Visit data
-        struct
+        int net = -1;
+        std::pair<int, PipId> data{0, PipId()};
+        std::unique_ptr<boost::container::flat_map<int, std::pair<int, PipId>>> overflow;
+
+        int size() const { return (net == -1) ? 0 : (1 + (overflow ? int(overflow->size()) : 0)); }
+        bool empty() const { return net == -1; }
+        bool count(int n) const { return net != -1 && (n == net || (overflow && overflow->count(n))); }
+        std::pair<int, PipId> &at(int n)
         {
-            bool dirty = false, visited = false;
-            PipId pip;
-            WireScore score;
-        } visit;
+            if (n == net)
+                return data;
+            NPNR_ASSERT(overflow);
+            return overflow->at(n);
+        }
+        std::pair<int, PipId> &operator[](int n)
+        {
+            if (net == -1 || n == net) {
+                net = n;
+                return data;
+            }
+            if (!overflow)
+                overflow.reset(new boost::container::flat_map<int, std::pair<int, PipId>>());
+            return (*overflow)[n];
+        }
+        void erase(int n)
+        {
+            if (n == net) {
+                if (overflow) {
+                    auto first = overflow->begin();
+                    net = first->first;
+                    data = first->second;
+                    overflow->erase(first);
+                } else {
+                    net = -1;
+                    data = std::make_pair(0, PipId());
+                }
+            } else if (overflow) {
+                overflow->erase(n);
+            }
+            if (overflow && overflow->empty())
+                overflow.reset();
+        }
+        template <typename Tf> void for_each(Tf func) const
+        {
+            if (net == -1)
+                return;
+            func(net, data);
+            if (overflow)
+                for (auto &o : *overflow)
+                    func(o.first, o.second);
+        }
     };
 
-    float present_wire_cost(const PerWireData &w, int net_uid)
+    // Search state of a visited wire. This is kept per thread, in the order wires were visited, so that only wires
+    // actually explored by the current arc take up space
+    struct WireVisit
     {
-        int other_sources = int(w.bound_nets.size());
-        if (w.bound_nets.count(net_uid))
-            other_sources -= 1;
+        int wire;
+        // Number of other nets bound to the wire when it was visited, to detect contention with concurrently
+        // routed nets
+        int others;
+        PipId pip;
+        WireScore score;
+    };
+
+    // Wires visited while routing an arc, in the order they were visited, and the slot of each in that list
+    // (indexed by wire, -1 if not visited)
+    struct VisitSet
+    {
+        std::vector<WireVisit> visits;
+        int32_t *slot = nullptr;
+
+        bool visited(int wire) const { return slot[wire] != -1; }
+        // Only valid for visited wires, and until the next call to set
+        WireVisit &get(int wire) { return visits[slot[wire]]; }
+        const WireVisit &get(int wire) const { return visits[slot[wire]]; }
+        void set(int wire, PipId pip, WireScore score, int others = 0)
+        {
+            int32_t &s = slot[wire];
+            if (s == -1) {
+                s = int32_t(visits.size());
+                visits.emplace_back();
+            }
+            auto &v = visits[s];
+            v.wire = wire;
+            v.others = others;
+            v.pip = pip;
+            v.score = score;
+        }
+        void reset()
+        {
+            for (auto &v : visits)
+                slot[v.wire] = -1;
+            visits.clear();
+        }
+    };
+
+    float present_wire_cost(int wire, int net_uid)
+    {
+        int other_sources = other_bound_nets(wire, net_uid);
         if (other_sources == 0)
             return 1.0f;
         else
@@ -115,7 +199,11 @@ struct Router2
     Context *ctx;
     Router2Cfg cfg;
 
-    Router2(Context *ctx, const Router2Cfg &cfg) : ctx(ctx), cfg(cfg), tmg(ctx) { tmg.setup(); }
+    Router2(Context *ctx, const Router2Cfg &cfg)
+            : ctx(ctx), cfg(cfg), tmg(ctx), pool(ThreadPool::default_threads(ctx))
+    {
+        tmg.setup();
+    }
 
     // Use 'udata' for fast net lookups and indexing
     std::vector<NetInfo *> nets_by_udata;
@@ -123,6 +211,7 @@ struct Router2
 
     bool timing_driven;
     TimingAnalyser tmg;
+    ThreadPool pool;
 
     void setup_nets()
     {
@@ -193,51 +282,164 @@ struct Router2
         }
     }
 
+    // Per-wire routing state, as a structure of arrays indexed by wire_idx(). Indices that the arch's dense wire
+    // index doesn't use are left with a null WireId and never touched
+    std::vector<WireId> wire_ids;
+    std::vector<BoundNets> wire_bound;
+    // Historical congestion cost
+    std::vector<float> wire_hist_cost;
+    // If not -1, only this net may use the wire; WIRE_UNAVAILABLE if the wire is locked to another arc
+    std::vector<int> wire_reserved;
+    static const int WIRE_UNAVAILABLE = -2;
+    // The notional location of the wire, to guarantee thread safety
+    struct WireLoc
+    {
+        int16_t x = 0, y = 0;
+    };
+    std::vector<WireLoc> wire_loc;
+
+    // Index of a wire in the arrays above; this comes from the arch if it has a dense wire index, otherwise from a
+    // map built at setup time
+    bool arch_wire_index = false;
     HashTables::HashMap<WireId, int> wire_to_idx;
-    std::vector<PerWireData> flat_wires;
+    int wire_idx(WireId w) const { return arch_wire_index ? ctx->getWireIndex(w) : wire_to_idx.at(w); }
+
+    // Slot of each wire in a thread's visit lists, or -1 if not visited; with a second array for the search from the
+    // sink in bidirectional mode. Threads that are restricted to disjoint regions share one set of arrays
+    std::vector<int32_t> shared_visit_slot;
+    // Per-thread visit slots for concurrent routing, allocated on first use
+    std::vector<std::vector<int32_t>> thread_visit_slot;
 
-    PerWireData &wire_data(WireId w) { return flat_wires[wire_to_idx.at(w)]; }
+    // While routing nets concurrently without region restrictions, the bound nets of a wire may only be accessed with
+    // its lock held. Locks are never nested, and are allocated on first use
+    bool concurrent_routing = false;
+    std::vector<std::atomic<bool>> wire_locks;
+
+    struct WireLock
+    {
+        WireLock(Router2 *router, int wire)
+                : flag(router->concurrent_routing ? &router->wire_locks[wire] : nullptr)
+        {
+            if (flag != nullptr)
+                while (flag->exchange(true, std::memory_order_acquire))
+                    ;
+        }
+        ~WireLock()
+        {
+            if (flag != nullptr)
+                flag->store(false, std::memory_order_release);
+        }
+        std::atomic<bool> *flag;
+    };
 
     void setup_wires()
     {
         // Set up per-wire structures, so that MT parts don't have to do any memory allocation
-        // This is possibly quite wasteful and not cache-optimal; further consideration necessary
+        int wire_count = ctx->getWireIndexCount();
+        arch_wire_index = (wire_count >= 0);
+        if (!arch_wire_index) {
+            wire_count = 0;
+            for (auto wire : ctx->getWires())
+                wire_to_idx[wire] = wire_count++;
+        }
+        wire_ids.resize(wire_count);
+        wire_bound.resize(wire_count);
+        wire_hist_cost.resize(wire_count, 1.0f);
+        wire_reserved.resize(wire_count, -1);
+        wire_loc.resize(wire_count);
         for (auto wire : ctx->getWires()) {
-            PerWireData pwd;
-            pwd.w = wire;
+            int idx = wire_idx(wire);
+            wire_ids[idx] = wire;
             NetInfo *bound = ctx->getBoundWireNet(wire);
             if (bound != nullptr) {
                 auto iter = bound->wires.find(wire);
                 if (iter != bound->wires.end()) {
-                    pwd.bound_nets[bound->udata] = std::make_pair(0, bound->wires.at(wire).pip);
+                    wire_bound[idx][bound->udata] = std::make_pair(0, bound->wires.at(wire).pip);
                     if (bound->wires.at(wire).strength == STRENGTH_PLACER) {
-                        pwd.reserved_net = bound->udata;
+                        wire_reserved[idx] = bound->udata;
                     } else if (bound->wires.at(wire).strength > STRENGTH_PLACER) {
-                        pwd.unavailable = true;
+                        wire_reserved[idx] = WIRE_UNAVAILABLE;
                     }
                 }
             }
 
-            ArcBounds wire_loc = ctx->getRouteBoundingBox(wire, wire);
-            pwd.x = (wire_loc.x0 + wire_loc.x1) / 2;
-            pwd.y = (wire_loc.y0 + wire_loc.y1) / 2;
-
-            wire_to_idx[wire] = int(flat_wires.size());
-            flat_wires.push_back(pwd);
+            ArcBounds bb = ctx->getRouteBoundingBox(wire, wire);
+            wire_loc[idx].x = (bb.x0 + bb.x1) / 2;
+            wire_loc[idx].y = (bb.y0 + bb.y1) / 2;
         }
+        shared_visit_slot.resize(wire_count * (cfg.bidirectional ? 2 : 1), -1);
 
+        std::vector<std::pair<int, int>> reused_wires;
+        if (!cfg.reuse_routing.empty())
+            reused_wires = load_previous_routing(cfg.reuse_routing);
+
+        int prerouted_arcs = 0, total_arcs = 0;
         for (auto net_pair : sorted(ctx->nets)) {
             auto *net = net_pair.second;
             auto &nd = nets.at(net->udata);
             for (size_t usr = 0; usr < net->users.size(); usr++) {
                 auto &ad = nd.arcs.at(usr);
                 for (size_t phys_pin = 0; phys_pin < ad.size(); phys_pin++) {
+                    ++total_arcs;
                     if (check_arc_routing(net, usr, phys_pin)) {
                         record_prerouted_net(net, usr, phys_pin);
+                        ++prerouted_arcs;
                     }
                 }
             }
         }
+
+        if (!cfg.reuse_routing.empty()) {
+            // Release previously routed wires that aren't part of a complete arc any more
+            for (auto &rw : reused_wires) {
+                auto &bn = wire_bound.at(rw.first);
+                if (bn.count(rw.second) && bn.at(rw.second).first == 0)
+                    bn.erase(rw.second);
+            }
+            log_info("Reusing previous routing for %d/%d arcs.\n", prerouted_arcs, total_arcs);
+        }
+    }
+
+    // Bind the wires of a previous routing, read from the ROUTING attributes of a JSON file, to their nets wherever
+    // they still exist and are free. Returns the (wire, net) pairs that were bound
+    std::vector<std::pair<int, int>> load_previous_routing(const std::string &filename)
+    {
+        std::unordered_map<IdString, std::string> routing;
+        std::vector<std::pair<int, int>> reused;
+        std::ifstream in(filename);
+        if (!in) {
+            log_warning("Failed to open '%s', routing from scratch.\n", filename.c_str());
+            return reused;
+        }
+        parse_json_routing(in, filename, ctx, routing);
+        for (auto &net_routing : routing) {
+            auto found = ctx->nets.find(net_routing.first);
+            if (found == ctx->nets.end() || found->second->driver.cell == nullptr)
+                continue;
+            NetInfo *net = found->second.get();
+            std::vector<std::string> strs;
+            boost::split(strs, net_routing.second, boost::is_any_of(";"));
+            // Entries are wire; driving pip (empty for the source wire); strength
+            for (size_t i = 0; i + 2 < strs.size(); i += 3) {
+                WireId wire = ctx->getWireByName(IdStringList::parse(ctx, strs.at(i)));
+                if (wire == WireId())
+                    continue;
+                PipId pip;
+                if (!strs.at(i + 1).empty()) {
+                    pip = ctx->getPipByName(IdStringList::parse(ctx, strs.at(i + 1)));
+                    if (pip == PipId() || ctx->getPipDstWire(pip) != wire || !ctx->checkPipAvailForNet(pip, net))
+                        continue;
+                }
+                int idx = wire_idx(wire);
+                if (!wire_bound.at(idx).empty())
+                    continue;
+                if (wire_reserved.at(idx) != -1 && wire_reserved.at(idx) != net->udata)
+                    continue;
+                wire_bound.at(idx)[net->udata] = std::make_pair(0, pip);
+                reused.emplace_back(idx, net->udata);
+            }
+        }
+        return reused;
     }
 
     struct QueuedWire
@@ -281,14 +483,19 @@ struct Router2
 
         std::vector<std::pair<size_t, size_t>> route_arcs;
 
-        std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> queue;
+        DAryHeap<QueuedWire, QueuedWire::Greater> queue;
+        // Queue of the search from the sink in bidirectional mode
+        DAryHeap<QueuedWire, QueuedWire::Greater> queue_bwd;
         // Special case where one net has multiple logical arcs to the same physical sink
         std::unordered_set<WireId> processed_sinks;
 
         // Backwards routing
         std::queue<int> backwards_queue;
 
-        std::vector<int> dirty_wires;
+        // Wires visited by the search from the source, and (in bidirectional mode) from the sink
+        VisitSet visit, visit_bwd;
+        // Set when a wire used by the last routed arc was taken by another net after being explored
+        bool conflict = false;
 
         // Thread bounding box
         ArcBounds bb;
@@ -296,9 +503,10 @@ struct Router2
         DeterministicRNG rng;
     };
 
-    bool thread_test_wire(ThreadContext &t, PerWireData &w)
+    bool thread_test_wire(ThreadContext &t, int wire)
     {
-        return w.x >= t.bb.x0 && w.x <= t.bb.x1 && w.y >= t.bb.y0 && w.y <= t.bb.y1;
+        const WireLoc &l = wire_loc[wire];
+        return l.x >= t.bb.x0 && l.x <= t.bb.x1 && l.y >= t.bb.y0 && l.y <= t.bb.y1;
     }
 
     enum ArcRouteResult
@@ -322,27 +530,41 @@ struct Router2
             log(__VA_ARGS__);                                                                                          \
     } while (0)
 
-    void bind_pip_internal(NetInfo *net, size_t user, int wire, PipId pip)
+    // Returns the number of other nets bound to the wire
+    int bind_pip_internal(NetInfo *net, size_t user, int wire, PipId pip)
     {
-        auto &b = flat_wires.at(wire).bound_nets[net->udata];
+        WireLock lock(this, wire);
+        auto &bn = wire_bound.at(wire);
+        auto &b = bn[net->udata];
         ++b.first;
         if (b.first == 1) {
             b.second = pip;
         } else {
             NPNR_ASSERT(b.second == pip);
         }
+        return bn.size() - 1;
     }
 
     void unbind_pip_internal(NetInfo *net, size_t user, WireId wire)
     {
-        auto &b = wire_data(wire).bound_nets.at(net->udata);
+        int idx = wire_idx(wire);
+        WireLock lock(this, idx);
+        auto &bn = wire_bound.at(idx);
+        auto &b = bn.at(net->udata);
         --b.first;
         NPNR_ASSERT(b.first >= 0);
         if (b.first == 0) {
-            wire_data(wire).bound_nets.erase(net->udata);
+            bn.erase(net->udata);
         }
     }
 
+    // Number of nets other than net_uid bound to a wire; the caller must hold the wire lock
+    int other_bound_nets(int wire, int net_uid)
+    {
+        const auto &bn = wire_bound[wire];
+        return bn.size() - int(bn.count(net_uid));
+    }
+
     void ripup_arc(NetInfo *net, size_t user, size_t phys_pin)
     {
         auto &ad = nets.at(net->udata).arcs.at(user).at(phys_pin);
@@ -351,31 +573,36 @@ struct Router2
         WireId src = nets.at(net->udata).src_wire;
         WireId cursor = ad.sink_wire;
         while (cursor != src) {
-            auto &wd = wire_data(cursor);
-            PipId pip = wd.bound_nets.at(net->udata).second;
+            int idx = wire_idx(cursor);
+            PipId pip;
+            {
+                WireLock lock(this, idx);
+                pip = wire_bound.at(idx).at(net->udata).second;
+            }
             unbind_pip_internal(net, user, cursor);
             cursor = ctx->getPipSrcWire(pip);
         }
         ad.routed = false;
     }
 
-    float score_wire_for_arc(NetInfo *net, size_t user, size_t phys_pin, WireId wire, PipId pip)
+    float score_wire_for_arc(NetInfo *net, size_t user, size_t phys_pin, int wire, PipId pip)
     {
-        auto &wd = wire_data(wire);
+        auto &bn = wire_bound[wire];
         auto &nd = nets.at(net->udata);
-        float base_cost = ctx->getDelayNS(ctx->getPipDelay(pip).maxDelay() + ctx->getWireDelay(wire).maxDelay() +
-                                          ctx->getDelayEpsilon());
-        float present_cost = present_wire_cost(wd, net->udata);
-        float hist_cost = wd.hist_cong_cost;
+        float base_cost = ctx->getDelayNS(ctx->getPipDelay(pip).maxDelay() +
+                                          ctx->getWireDelay(wire_ids[wire]).maxDelay() + ctx->getDelayEpsilon());
+        float present_cost = present_wire_cost(wire, net->udata);
+        float hist_cost = wire_hist_cost[wire];
         float bias_cost = 0;
         int source_uses = 0;
-        if (wd.bound_nets.count(net->udata))
-            source_uses = wd.bound_nets.at(net->udata).first;
+        if (bn.count(net->udata))
+            source_uses = bn.at(net->udata).first;
         if (timing_driven) {
             float max_bound_crit = 0;
-            for (auto &bound : wd.bound_nets)
-                if (bound.first != net->udata)
-                    max_bound_crit = std::max(max_bound_crit, nets.at(bound.first).max_crit);
+            bn.for_each([&](int bound_net, const std::pair<int, PipId> &) {
+                if (bound_net != net->udata)
+                    max_bound_crit = std::max(max_bound_crit, nets.at(bound_net).max_crit);
+            });
             if (max_bound_crit >= 0.8 && nd.arcs.at(user).at(phys_pin).arc_crit < (max_bound_crit + 0.01)) {
                 present_cost *= 1.5;
             }
@@ -390,12 +617,12 @@ struct Router2
 
     float get_togo_cost(NetInfo *net, size_t user, int wire, WireId sink, delay_t *delay)
     {
-        auto &wd = flat_wires[wire];
+        auto &bn = wire_bound[wire];
         int source_uses = 0;
-        if (wd.bound_nets.count(net->udata))
-            source_uses = wd.bound_nets.at(net->udata).first;
+        if (bn.count(net->udata))
+            source_uses = bn.at(net->udata).first;
         // FIXME: timing/wirelength balance?
-        *delay = ctx->estimateDelay(wd.w, sink);
+        *delay = ctx->estimateDelay(wire_ids[wire], sink);
         return (ctx->getDelayNS(*delay) / (1 + source_uses)) + cfg.ipin_cost_adder;
     }
 
@@ -404,11 +631,18 @@ struct Router2
         auto &ad = nets.at(net->udata).arcs.at(usr).at(phys_pin);
         WireId src_wire = nets.at(net->udata).src_wire;
         WireId cursor = ad.sink_wire;
-        while (wire_data(cursor).bound_nets.count(net->udata)) {
-            auto &wd = wire_data(cursor);
-            if (wd.bound_nets.size() != 1)
-                return false;
-            auto &uh = wd.bound_nets.at(net->udata).second;
+        while (true) {
+            int idx = wire_idx(cursor);
+            PipId uh;
+            {
+                WireLock lock(this, idx);
+                auto &bn = wire_bound.at(idx);
+                if (!bn.count(net->udata))
+                    break;
+                if (bn.size() != 1)
+                    return false;
+                uh = bn.at(net->udata).second;
+            }
             if (uh == PipId())
                 break;
             cursor = ctx->getPipSrcWire(uh);
@@ -424,10 +658,9 @@ struct Router2
         WireId src = nets.at(net->udata).src_wire;
         WireId cursor = ad.sink_wire;
         while (cursor != src) {
-            size_t wire_idx = wire_to_idx.at(cursor);
-            auto &wd = flat_wires.at(wire_idx);
-            PipId pip = wd.bound_nets.at(net->udata).second;
-            bind_pip_internal(net, usr, wire_idx, pip);
+            int idx = wire_idx(cursor);
+            PipId pip = wire_bound.at(idx).at(net->udata).second;
+            bind_pip_internal(net, usr, idx, pip);
             cursor = ctx->getPipSrcWire(pip);
         }
     }
@@ -455,10 +688,11 @@ struct Router2
             if (ctx->debug)
                 log("reserving wires for arc %d of net %s\n", int(i), ctx->nameOf(net));
             while (!done) {
-                auto &wd = wire_data(cursor);
+                int &reserved = wire_reserved.at(wire_idx(cursor));
                 if (ctx->debug)
                     log("      %s\n", ctx->nameOfWire(cursor));
-                wd.reserved_net = net->udata;
+                if (reserved != WIRE_UNAVAILABLE)
+                    reserved = net->udata;
                 if (cursor == src)
                     break;
                 WireId next_cursor;
@@ -490,28 +724,26 @@ struct Router2
         }
     }
 
+    void attach_visit_slots(ThreadContext &t, std::vector<int32_t> &slots)
+    {
+        t.visit.slot = slots.data();
+        if (cfg.bidirectional)
+            t.visit_bwd.slot = slots.data() + wire_ids.size();
+    }
+
     void reset_wires(ThreadContext &t)
     {
-        for (auto w : t.dirty_wires) {
-            flat_wires[w].visit.visited = false;
-            flat_wires[w].visit.dirty = false;
-            flat_wires[w].visit.pip = PipId();
-            flat_wires[w].visit.score = WireScore();
-        }
-        t.dirty_wires.clear();
+        t.visit.reset();
+        t.visit_bwd.reset();
     }
 
-    void set_visited(ThreadContext &t, int wire, PipId pip, WireScore score)
+    // Bind a wire along a newly found route, flagging a conflict if another net took it since it was explored
+    void bind_visited(ThreadContext &t, const VisitSet &vs, NetInfo *net, size_t user, int wire, PipId pip)
     {
-        auto &v = flat_wires.at(wire).visit;
-        if (!v.dirty)
-            t.dirty_wires.push_back(wire);
-        v.dirty = true;
-        v.visited = true;
-        v.pip = pip;
-        v.score = score;
+        int others = bind_pip_internal(net, user, wire, pip);
+        if (concurrent_routing && others > (vs.visited(wire) ? vs.get(wire).others : 0))
+            t.conflict = true;
     }
-    bool was_visited(int wire) { return flat_wires.at(wire).visit.visited; }
 
     ArcRouteResult route_arc(ThreadContext &t, NetInfo *net, size_t i, size_t phys_pin, bool is_mt, bool is_bb = true)
     {
@@ -528,16 +760,14 @@ struct Router2
         if (dst_wire == WireId())
             ARC_LOG_ERR("No wire found for port %s on destination cell %s.\n", ctx->nameOf(usr.port),
                         ctx->nameOf(usr.cell));
-        int src_wire_idx = wire_to_idx.at(src_wire);
-        int dst_wire_idx = wire_to_idx.at(dst_wire);
+        int src_wire_idx = wire_idx(src_wire);
+        int dst_wire_idx = wire_idx(dst_wire);
         // Check if arc was already done _in this iteration_
         if (t.processed_sinks.count(dst_wire))
             return ARC_SUCCESS;
 
-        if (!t.queue.empty()) {
-            std::priority_queue<QueuedWire, std::vector<QueuedWire>, QueuedWire::Greater> new_queue;
-            t.queue.swap(new_queue);
-        }
+        t.queue.clear();
+        t.queue_bwd.clear();
         if (!t.backwards_queue.empty()) {
             std::queue<int> new_queue;
             t.backwards_queue.swap(new_queue);
@@ -550,79 +780,89 @@ struct Router2
         int backwards_iter = 0;
         int backwards_limit =
                 ctx->getBelGlobalBuf(net->driver.cell->bel) ? cfg.global_backwards_max_iter : cfg.backwards_max_iter;
-        t.backwards_queue.push(wire_to_idx.at(dst_wire));
+        t.backwards_queue.push(dst_wire_idx);
+        // Returns true and the driving pip if a wire is bound to this net
+        auto bound_pip = [&](int wire, PipId &pip) {
+            WireLock lock(this, wire);
+            auto &bn = wire_bound.at(wire);
+            if (!bn.count(net->udata))
+                return false;
+            pip = bn.at(net->udata).second;
+            return true;
+        };
         while (!t.backwards_queue.empty() && backwards_iter < backwards_limit) {
             int cursor = t.backwards_queue.front();
             t.backwards_queue.pop();
-            auto &cwd = flat_wires[cursor];
             PipId cpip;
-            if (cwd.bound_nets.count(net->udata)) {
+            if (bound_pip(cursor, cpip)) {
                 // If we can tack onto existing routing; try that
                 // Only do this if the existing routing is uncontented; however
                 int cursor2 = cursor;
                 bool bwd_merge_fail = false;
-                while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
-                    if (flat_wires.at(cursor2).bound_nets.size() > 1) {
-                        bwd_merge_fail = true;
-                        break;
+                PipId p;
+                while (true) {
+                    {
+                        WireLock lock(this, cursor2);
+                        auto &bn2 = wire_bound.at(cursor2);
+                        if (!bn2.count(net->udata))
+                            break;
+                        if (bn2.size() > 1) {
+                            bwd_merge_fail = true;
+                            break;
+                        }
+                        p = bn2.at(net->udata).second;
                     }
-                    PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
                     if (p == PipId())
                         break;
-                    cursor2 = wire_to_idx.at(ctx->getPipSrcWire(p));
+                    cursor2 = wire_idx(ctx->getPipSrcWire(p));
                 }
                 if (!bwd_merge_fail && cursor2 == src_wire_idx) {
                     // Found a path to merge to existing routing; backwards
                     cursor2 = cursor;
-                    while (flat_wires.at(cursor2).bound_nets.count(net->udata)) {
-                        PipId p = flat_wires.at(cursor2).bound_nets.at(net->udata).second;
-                        if (p == PipId())
-                            break;
-                        cursor2 = wire_to_idx.at(ctx->getPipSrcWire(p));
-                        set_visited(t, cursor2, p, WireScore());
+                    while (bound_pip(cursor2, p) && p != PipId()) {
+                        cursor2 = wire_idx(ctx->getPipSrcWire(p));
+                        t.visit.set(cursor2, p, WireScore());
                     }
                     break;
                 }
-                cpip = cwd.bound_nets.at(net->udata).second;
             }
             bool did_something = false;
-            for (auto uh : ctx->getPipsUphill(flat_wires[cursor].w)) {
+            for (auto uh : ctx->getPipsUphill(wire_ids[cursor])) {
                 did_something = true;
                 if (!ctx->checkPipAvailForNet(uh, net))
                     continue;
                 if (cpip != PipId() && cpip != uh)
                     continue; // don't allow multiple pips driving a wire with a net
-                int next = wire_to_idx.at(ctx->getPipSrcWire(uh));
-                if (was_visited(next))
+                int next = wire_idx(ctx->getPipSrcWire(uh));
+                if (t.visit.visited(next))
                     continue; // skip wires that have already been visited
-                auto &wd = flat_wires[next];
-                if (wd.unavailable)
+                if (wire_reserved[next] != -1 && wire_reserved[next] != net->udata)
                     continue;
-                if (wd.reserved_net != -1 && wd.reserved_net != net->udata)
-                    continue;
-                if (wd.bound_nets.size() > 1 || (wd.bound_nets.size() == 1 && !wd.bound_nets.count(net->udata)))
-                    continue; // never allow congestion in backwards routing
-                if (!thread_test_wire(t, wd))
+                {
+                    WireLock lock(this, next);
+                    if (other_bound_nets(next, net->udata) > 0)
+                        continue; // never allow congestion in backwards routing
+                }
+                if (!thread_test_wire(t, next))
                     continue; // thread safety issue
                 t.backwards_queue.push(next);
-                set_visited(t, next, uh, WireScore());
+                t.visit.set(next, uh, WireScore());
             }
             if (did_something)
                 ++backwards_iter;
         }
         // Check if backwards routing succeeded in reaching source
-        if (was_visited(src_wire_idx)) {
+        if (t.visit.visited(src_wire_idx)) {
             ROUTE_LOG_DBG("   Routed (backwards): ");
             int cursor_fwd = src_wire_idx;
-            bind_pip_internal(net, i, src_wire_idx, PipId());
-            while (was_visited(cursor_fwd)) {
-                auto &v = flat_wires.at(cursor_fwd).visit;
-                cursor_fwd = wire_to_idx.at(ctx->getPipDstWire(v.pip));
-                bind_pip_internal(net, i, cursor_fwd, v.pip);
+            bind_visited(t, t.visit, net, i, src_wire_idx, PipId());
+            while (t.visit.visited(cursor_fwd)) {
+                auto &v = t.visit.get(cursor_fwd);
+                cursor_fwd = wire_idx(ctx->getPipDstWire(v.pip));
+                bind_visited(t, t.visit, net, i, cursor_fwd, v.pip);
                 if (ctx->debug) {
-                    auto &wd = flat_wires.at(cursor_fwd);
-                    ROUTE_LOG_DBG("      wire: %s (curr %d hist %f)\n", ctx->nameOfWire(wd.w),
-                                  int(wd.bound_nets.size()) - 1, wd.hist_cong_cost);
+                    ROUTE_LOG_DBG("      wire: %s (curr %d hist %f)\n", ctx->nameOfWire(wire_ids[cursor_fwd]),
+                                  wire_bound[cursor_fwd].size() - 1, wire_hist_cost[cursor_fwd]);
                 }
             }
             NPNR_ASSERT(cursor_fwd == dst_wire_idx);
@@ -634,11 +874,30 @@ struct Router2
 
         // Normal forwards A* routing
         reset_wires(t);
+        if (cfg.bidirectional) {
+            int explored = 0;
+            bool found = route_arc_bidir(t, net, i, phys_pin, is_mt, is_bb, src_wire_idx, dst_wire_idx, explored);
+            reset_wires(t);
+            auto arc_end = std::chrono::high_resolution_clock::now();
+            ROUTE_LOG_DBG("%s arc %d of net '%s' (is_bb = %d, explored %d wires) took %02fs\n",
+                          found ? "Routing" : "Failed routing", int(i), ctx->nameOf(net), is_bb, explored,
+                          std::chrono::duration<float>(arc_end - arc_start).count());
+            if (!found)
+                return ARC_RETRY_WITHOUT_BB;
+            t.processed_sinks.insert(dst_wire);
+            ad.routed = true;
+            return ARC_SUCCESS;
+        }
         WireScore base_score;
         base_score.cost = 0;
         base_score.delay = ctx->getWireDelay(src_wire).maxDelay();
         delay_t forward;
-        base_score.togo_cost = get_togo_cost(net, i, src_wire_idx, dst_wire, &forward);
+        int src_others;
+        {
+            WireLock lock(this, src_wire_idx);
+            base_score.togo_cost = get_togo_cost(net, i, src_wire_idx, dst_wire, &forward);
+            src_others = other_bound_nets(src_wire_idx, net->udata);
+        }
 
         ROUTE_LOG_DBG("src_wire = %s -> dst_wire = %s (backward: %s, forward: %s, sum: %s)\n",
                       ctx->nameOfWire(src_wire), ctx->nameOfWire(dst_wire), std::to_string(base_score.delay).c_str(),
@@ -646,7 +905,7 @@ struct Router2
 
         // Add source wire to queue
         t.queue.push(QueuedWire(src_wire_idx, PipId(), Loc(), base_score));
-        set_visited(t, src_wire_idx, PipId(), base_score);
+        t.visit.set(src_wire_idx, PipId(), base_score, src_others);
 
         int toexplore = 25000 * std::max(1, (ad.bb.x1 - ad.bb.x0) + (ad.bb.y1 - ad.bb.y0));
         int iter = 0;
@@ -667,14 +926,14 @@ struct Router2
         bool must_drain_queue = !is_bb;
         while (!t.queue.empty() && (must_drain_queue || iter < toexplore)) {
             auto curr = t.queue.top();
-            auto &d = flat_wires.at(curr.wire);
+            WireId curr_wire = wire_ids[curr.wire];
             t.queue.pop();
             ++iter;
 #if 0
-            ROUTE_LOG_DBG("current wire %s\n", ctx->nameOfWire(d.w));
+            ROUTE_LOG_DBG("current wire %s\n", ctx->nameOfWire(curr_wire));
 #endif
             // Explore all pips downhill of cursor
-            for (auto dh : ctx->getPipsDownhill(d.w)) {
+            for (auto dh : ctx->getPipsDownhill(curr_wire)) {
                 // Skip pips outside of box in bounding-box mode
 #if 0
                 ROUTE_LOG_DBG("trying pip %s\n", ctx->nameOfPip(dh));
@@ -696,8 +955,8 @@ struct Router2
 #endif
                 // Evaluate score of next wire
                 WireId next = ctx->getPipDstWire(dh);
-                int next_idx = wire_to_idx.at(next);
-                if (was_visited(next_idx)) {
+                int next_idx = wire_idx(next);
+                if (t.visit.visited(next_idx)) {
                     // Don't expand the same node twice.
                     continue;
                 }
@@ -705,20 +964,23 @@ struct Router2
                 if (debug_arc)
                     ROUTE_LOG_DBG("   src wire %s\n", ctx->nameOfWire(next));
 #endif
-                auto &nwd = flat_wires.at(next_idx);
-                if (nwd.unavailable)
+                if (wire_reserved[next_idx] != -1 && wire_reserved[next_idx] != net->udata)
                     continue;
-                if (nwd.reserved_net != -1 && nwd.reserved_net != net->udata)
-                    continue;
-                if (nwd.bound_nets.count(net->udata) && nwd.bound_nets.at(net->udata).second != dh)
-                    continue;
-                if (!thread_test_wire(t, nwd))
+                if (!thread_test_wire(t, next_idx))
                     continue; // thread safety issue
                 WireScore next_score;
-                next_score.cost = curr.score.cost + score_wire_for_arc(net, i, phys_pin, next, dh);
+                int next_others;
+                {
+                    WireLock lock(this, next_idx);
+                    auto &nbn = wire_bound[next_idx];
+                    if (nbn.count(net->udata) && nbn.at(net->udata).second != dh)
+                        continue;
+                    next_score.cost = curr.score.cost + score_wire_for_arc(net, i, phys_pin, next_idx, dh);
+                    next_score.togo_cost = cfg.estimate_weight * get_togo_cost(net, i, next_idx, dst_wire, &forward);
+                    next_others = other_bound_nets(next_idx, net->udata);
+                }
                 next_score.delay =
                         curr.score.delay + ctx->getPipDelay(dh).maxDelay() + ctx->getWireDelay(next).maxDelay();
-                next_score.togo_cost = cfg.estimate_weight * get_togo_cost(net, i, next_idx, dst_wire, &forward);
                 ROUTE_LOG_DBG(
                         "src_wire = %s -> next %s -> dst_wire = %s (backward: %s, forward: %s, sum: %s, cost = %f, "
                         "togo_cost = %f, total = %f), dt = %02fs\n",
@@ -727,8 +989,7 @@ struct Router2
                         std::to_string(next_score.delay + forward).c_str(), next_score.cost, next_score.togo_cost,
                         next_score.cost + next_score.togo_cost,
                         std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - arc_start).count());
-                const auto &v = nwd.visit;
-                if (!v.visited || (v.score.total() > next_score.total())) {
+                if (!t.visit.visited(next_idx) || (t.visit.get(next_idx).score.total() > next_score.total())) {
                     ++explored;
 #if 0
                     ROUTE_LOG_DBG("exploring wire %s cost %f togo %f\n", ctx->nameOfWire(next), next_score.cost,
@@ -736,7 +997,7 @@ struct Router2
 #endif
                     // Add wire to queue if it meets criteria
                     t.queue.push(QueuedWire(next_idx, dh, ctx->getPipLocation(dh), next_score, t.rng.rng()));
-                    set_visited(t, next_idx, dh, next_score);
+                    t.visit.set(next_idx, dh, next_score, next_others);
                     if (next == dst_wire) {
                         toexplore = std::min(toexplore, iter + 5);
                         must_drain_queue = false;
@@ -744,17 +1005,17 @@ struct Router2
                 }
             }
         }
-        if (was_visited(dst_wire_idx)) {
+        if (t.visit.visited(dst_wire_idx)) {
             ROUTE_LOG_DBG("   Routed (explored %d wires): ", explored);
             int cursor_bwd = dst_wire_idx;
-            while (was_visited(cursor_bwd)) {
-                auto &v = flat_wires.at(cursor_bwd).visit;
-                bind_pip_internal(net, i, cursor_bwd, v.pip);
+            while (t.visit.visited(cursor_bwd)) {
+                auto &v = t.visit.get(cursor_bwd);
+                bind_visited(t, t.visit, net, i, cursor_bwd, v.pip);
                 if (ctx->debug) {
-                    auto &wd = flat_wires.at(cursor_bwd);
-                    ROUTE_LOG_DBG("      wire: %s (curr %d hist %f share %d)\n", ctx->nameOfWire(wd.w),
-                                  int(wd.bound_nets.size()) - 1, wd.hist_cong_cost,
-                                  wd.bound_nets.count(net->udata) ? wd.bound_nets.at(net->udata).first : 0);
+                    auto &bn = wire_bound[cursor_bwd];
+                    ROUTE_LOG_DBG("      wire: %s (curr %d hist %f share %d)\n", ctx->nameOfWire(wire_ids[cursor_bwd]),
+                                  bn.size() - 1, wire_hist_cost[cursor_bwd],
+                                  bn.count(net->udata) ? bn.at(net->udata).first : 0);
                 }
                 if (v.pip == PipId()) {
                     NPNR_ASSERT(cursor_bwd == src_wire_idx);
@@ -762,7 +1023,7 @@ struct Router2
                 }
                 ROUTE_LOG_DBG("         pip: %s (%d, %d)\n", ctx->nameOfPip(v.pip), ctx->getPipLocation(v.pip).x,
                               ctx->getPipLocation(v.pip).y);
-                cursor_bwd = wire_to_idx.at(ctx->getPipSrcWire(v.pip));
+                cursor_bwd = wire_idx(ctx->getPipSrcWire(v.pip));
             }
             t.processed_sinks.insert(dst_wire);
             ad.routed = true;
@@ -780,6 +1041,185 @@ struct Router2
             return ARC_RETRY_WITHOUT_BB;
         }
     }
+
+    // Bidirectional A*: search forwards from the source and backwards from the sink at the same time, always
+    // expanding the smaller of the two wavefronts, until they meet. Both searches use the same potential function, the
+    // average of the estimated delays to the sink and from the source, so that their heuristics are consistent and
+    // the search can finish as soon as neither queue can improve on the best meeting point. Binds the best path found
+    // and returns true on success. As in route_arc, is_mt suppresses debug logging when called from a worker thread
+    bool route_arc_bidir(ThreadContext &t, NetInfo *net, size_t i, size_t phys_pin, bool is_mt, bool is_bb, int src,
+                         int dst, int &explored)
+    {
+        auto &ad = nets.at(net->udata).arcs.at(i).at(phys_pin);
+        WireId src_wire = wire_ids[src], dst_wire = wire_ids[dst];
+        auto potential = [&](int wire) {
+            return 0.5f * cfg.estimate_weight *
+                   (ctx->getDelayNS(ctx->estimateDelay(wire_ids[wire], dst_wire)) -
+                    ctx->getDelayNS(ctx->estimateDelay(src_wire, wire_ids[wire])));
+        };
+        // Best path found so far, as the wire where the two searches meet
+        int meet = -1;
+        float meet_cost = std::numeric_limits<float>::max();
+        auto check_meet = [&](int wire) {
+            if (!t.visit.visited(wire) || !t.visit_bwd.visited(wire))
+                return;
+            float cost = t.visit.get(wire).score.cost + t.visit_bwd.get(wire).score.cost;
+            if (cost < meet_cost) {
+                meet = wire;
+                meet_cost = cost;
+            }
+        };
+
+        WireScore src_score, dst_score;
+        src_score.cost = 0;
+        src_score.togo_cost = potential(src);
+        src_score.delay = ctx->getWireDelay(src_wire).maxDelay();
+        dst_score.cost = 0;
+        dst_score.togo_cost = -potential(dst);
+        dst_score.delay = 0;
+        int src_others, dst_others;
+        {
+            WireLock lock(this, src);
+            src_others = other_bound_nets(src, net->udata);
+        }
+        {
+            WireLock lock(this, dst);
+            dst_others = other_bound_nets(dst, net->udata);
+        }
+        t.queue.push(QueuedWire(src, PipId(), Loc(), src_score));
+        t.visit.set(src, PipId(), src_score, src_others);
+        t.queue_bwd.push(QueuedWire(dst, PipId(), Loc(), dst_score));
+        t.visit_bwd.set(dst, PipId(), dst_score, dst_others);
+        check_meet(dst);
+        explored = 2;
+
+        int toexplore = 25000 * std::max(1, (ad.bb.x1 - ad.bb.x0) + (ad.bb.y1 - ad.bb.y0));
+        int iter = 0;
+        // As for forward routing, the exploration limit is suspended without a bounding box until a route is found
+        bool must_drain_queue = !is_bb;
+        while (!t.queue.empty() && !t.queue_bwd.empty() && (must_drain_queue || iter < toexplore)) {
+            if (meet != -1 && (t.queue.top().score.total() + t.queue_bwd.top().score.total()) >= meet_cost)
+                break;
+            ++iter;
+            if (t.queue.size() <= t.queue_bwd.size()) {
+                auto curr = t.queue.top();
+                t.queue.pop();
+                for (auto dh : ctx->getPipsDownhill(wire_ids[curr.wire])) {
+                    if (is_bb && !hit_test_pip(ad.bb, ctx->getPipLocation(dh)))
+                        continue;
+                    if (!ctx->checkPipAvailForNet(dh, net))
+                        continue;
+                    WireId next_wire = ctx->getPipDstWire(dh);
+                    int next = wire_idx(next_wire);
+                    if (t.visit.visited(next))
+                        continue;
+                    if (wire_reserved[next] != -1 && wire_reserved[next] != net->udata)
+                        continue;
+                    if (!thread_test_wire(t, next))
+                        continue; // thread safety issue
+                    WireScore next_score;
+                    int next_others;
+                    {
+                        WireLock lock(this, next);
+                        auto &nbn = wire_bound[next];
+                        if (nbn.count(net->udata) && nbn.at(net->udata).second != dh)
+                            continue;
+                        next_score.cost = curr.score.cost + score_wire_for_arc(net, i, phys_pin, next, dh);
+                        next_others = other_bound_nets(next, net->udata);
+                    }
+                    next_score.togo_cost = potential(next);
+                    next_score.delay = curr.score.delay + ctx->getPipDelay(dh).maxDelay() +
+                                       ctx->getWireDelay(next_wire).maxDelay();
+                    ++explored;
+                    t.queue.push(QueuedWire(next, dh, ctx->getPipLocation(dh), next_score, t.rng.rng()));
+                    t.visit.set(next, dh, next_score, next_others);
+                    check_meet(next);
+                }
+            } else {
+                // The cost of a pip and the wire it drives is added when the backwards search crosses the pip
+                auto curr = t.queue_bwd.top();
+                t.queue_bwd.pop();
+                WireId curr_wire = wire_ids[curr.wire];
+                for (auto uh : ctx->getPipsUphill(curr_wire)) {
+                    if (is_bb && !hit_test_pip(ad.bb, ctx->getPipLocation(uh)))
+                        continue;
+                    if (!ctx->checkPipAvailForNet(uh, net))
+                        continue;
+                    int prev = wire_idx(ctx->getPipSrcWire(uh));
+                    if (t.visit_bwd.visited(prev))
+                        continue;
+                    if (wire_reserved[prev] != -1 && wire_reserved[prev] != net->udata)
+                        continue;
+                    if (!thread_test_wire(t, prev))
+                        continue; // thread safety issue
+                    WireScore prev_score;
+                    int prev_others;
+                    {
+                        WireLock lock(this, curr.wire);
+                        auto &cbn = wire_bound[curr.wire];
+                        if (cbn.count(net->udata) && cbn.at(net->udata).second != uh)
+                            continue;
+                        prev_score.cost = curr.score.cost + score_wire_for_arc(net, i, phys_pin, curr.wire, uh);
+                    }
+                    {
+                        WireLock lock(this, prev);
+                        prev_others = other_bound_nets(prev, net->udata);
+                    }
+                    prev_score.togo_cost = -potential(prev);
+                    prev_score.delay = curr.score.delay + ctx->getPipDelay(uh).maxDelay() +
+                                       ctx->getWireDelay(curr_wire).maxDelay();
+                    ++explored;
+                    t.queue_bwd.push(QueuedWire(prev, uh, ctx->getPipLocation(uh), prev_score, t.rng.rng()));
+                    t.visit_bwd.set(prev, uh, prev_score, prev_others);
+                    check_meet(prev);
+                }
+            }
+            if (meet != -1 && must_drain_queue) {
+                // Like forward routing, don't wait long for a better route once one has been found
+                toexplore = std::min(toexplore, iter + 5);
+                must_drain_queue = false;
+            }
+        }
+        if (meet == -1)
+            return false;
+
+        // Assemble the route from the source to the sink, as (wire, driving pip, other nets when visited)
+        std::vector<std::tuple<int, PipId, int>> route;
+        for (int cursor = meet;;) {
+            auto &v = t.visit.get(cursor);
+            route.emplace_back(cursor, v.pip, v.others);
+            if (v.pip == PipId()) {
+                NPNR_ASSERT(cursor == src);
+                break;
+            }
+            cursor = wire_idx(ctx->getPipSrcWire(v.pip));
+        }
+        std::reverse(route.begin(), route.end());
+        for (int cursor = meet; cursor != dst;) {
+            PipId pip = t.visit_bwd.get(cursor).pip;
+            cursor = wire_idx(ctx->getPipDstWire(pip));
+            route.emplace_back(cursor, pip, t.visit_bwd.get(cursor).others);
+        }
+        // The two halves of the route may cross each other; cut out the resulting loops
+        std::vector<std::tuple<int, PipId, int>> loop_free;
+        for (auto &r : route) {
+            auto found = std::find_if(loop_free.begin(), loop_free.end(), [&](const std::tuple<int, PipId, int> &l) {
+                return std::get<0>(l) == std::get<0>(r);
+            });
+            if (found != loop_free.end())
+                loop_free.erase(found + 1, loop_free.end());
+            else
+                loop_free.push_back(r);
+        }
+        ROUTE_LOG_DBG("   Routed (bidirectional, explored %d wires):\n", explored);
+        for (auto &r : loop_free) {
+            int others = bind_pip_internal(net, i, std::get<0>(r), std::get<1>(r));
+            if (concurrent_routing && others > std::get<2>(r))
+                t.conflict = true;
+            ROUTE_LOG_DBG("      wire: %s\n", ctx->nameOfWire(wire_ids[std::get<0>(r)]));
+        }
+        return true;
+    }
 #undef ARC_ERR
 
     bool route_net(ThreadContext &t, NetInfo *net, bool is_mt)
@@ -859,15 +1299,15 @@ struct Router2
         overused_wires = 0;
         total_wire_use = 0;
         failed_nets.clear();
-        for (auto &wire : flat_wires) {
-            total_wire_use += int(wire.bound_nets.size());
-            int overuse = int(wire.bound_nets.size()) - 1;
+        for (int wire = 0; wire < int(wire_bound.size()); wire++) {
+            auto &bn = wire_bound[wire];
+            total_wire_use += bn.size();
+            int overuse = bn.size() - 1;
             if (overuse > 0) {
-                wire.hist_cong_cost = std::min(1e9, wire.hist_cong_cost + overuse * hist_cong_weight);
+                wire_hist_cost[wire] = std::min(1e9, wire_hist_cost[wire] + overuse * hist_cong_weight);
                 total_overuse += overuse;
                 overused_wires += 1;
-                for (auto &bound : wire.bound_nets)
-                    failed_nets.insert(bound.first);
+                bn.for_each([&](int bound_net, const std::pair<int, PipId> &) { failed_nets.insert(bound_net); });
             }
         }
     }
@@ -921,13 +1361,13 @@ struct Router2
                     break;
                 }
             }
-            auto &wd = wire_data(cursor);
-            if (!wd.bound_nets.count(net->udata)) {
+            auto &bn = wire_bound.at(wire_idx(cursor));
+            if (!bn.count(net->udata)) {
                 log("Failure details:\n");
                 log("    Cursor: %s\n", ctx->nameOfWire(cursor));
                 log_error("Internal error; incomplete route tree for arc %d of net %s.\n", usr_idx, ctx->nameOf(net));
             }
-            auto &p = wd.bound_nets.at(net->udata).second;
+            auto &p = bn.at(net->udata).second;
             if (!ctx->checkPipAvail(p)) {
                 NetInfo *bound_net = ctx->getBoundPipNet(p);
                 if (bound_net != net) {
@@ -1006,17 +1446,16 @@ struct Router2
     {
         std::vector<std::vector<int>> hm_xy;
         int max_x = 0, max_y = 0;
-        for (auto &wd : flat_wires) {
-            int val = int(wd.bound_nets.size()) - (congestion ? 1 : 0);
-            if (wd.bound_nets.empty())
+        for (auto &bn : wire_bound) {
+            int val = bn.size() - (congestion ? 1 : 0);
+            if (bn.empty())
                 continue;
             // Estimate wire location by driving pip location
             PipId drv;
-            for (auto &bn : wd.bound_nets)
-                if (bn.second.second != PipId()) {
-                    drv = bn.second.second;
-                    break;
-                }
+            bn.for_each([&](int, const std::pair<int, PipId> &b) {
+                if (drv == PipId())
+                    drv = b.second;
+            });
             if (drv == PipId())
                 continue;
             Loc l = ctx->getPipLocation(drv);
@@ -1039,51 +1478,116 @@ struct Router2
             out << std::endl;
         }
     }
-    int mid_x = 0, mid_y = 0;
+    // Routing is split up by recursive bisection of the device into one leaf region per thread. Nets that fit
+    // within a region (with margin) are routed by the deepest node that contains them; sibling regions don't
+    // overlap, so sibling subtrees can be routed concurrently, and a node is routed after its children
+    struct PartitionNode
+    {
+        // Region that nets of this node are routed within
+        ArcBounds bb;
+        // Split point of the region between the two children; lower child gets [.., split] and the upper child
+        // gets [split + 1, ..]. -1 for leaves
+        int split = -1;
+        bool split_x = false;
+        int parent = -1;
+        std::array<int, 2> children{{-1, -1}};
+    };
+    std::vector<PartitionNode> partitions;
 
-    void partition_nets()
+    void bisect_partition(int node, std::vector<std::pair<int, int>> &centroids, int leaves)
     {
-        // Create a histogram of positions in X and Y positions
-        std::map<int, int> cxs, cys;
-        for (auto &n : nets) {
-            if (n.cx != -1)
-                ++cxs[n.cx];
-            if (n.cy != -1)
-                ++cys[n.cy];
+        if (leaves <= 1 || centroids.size() < 2)
+            return;
+        // Split the axis over which net centroids are most spread out
+        int min_x = std::numeric_limits<int>::max(), max_x = std::numeric_limits<int>::min();
+        int min_y = std::numeric_limits<int>::max(), max_y = std::numeric_limits<int>::min();
+        for (auto &c : centroids) {
+            min_x = std::min(min_x, c.first);
+            max_x = std::max(max_x, c.first);
+            min_y = std::min(min_y, c.second);
+            max_y = std::max(max_y, c.second);
         }
-        // 4-way split for now
-        int accum_x = 0, accum_y = 0;
-        int halfway = int(nets.size()) / 2;
-        for (auto &p : cxs) {
-            if (accum_x < halfway && (accum_x + p.second) >= halfway)
-                mid_x = p.first;
-            accum_x += p.second;
+        bool split_x = (max_x - min_x) >= (max_y - min_y);
+        auto coord = [&](const std::pair<int, int> &c) { return split_x ? c.first : c.second; };
+        // The lower half gets a number of nets proportional to the number of leaves it will be divided into
+        int lower_leaves = leaves / 2;
+        size_t k = (centroids.size() * lower_leaves) / leaves;
+        std::nth_element(
+                centroids.begin(), centroids.begin() + k, centroids.end(),
+                [&](const std::pair<int, int> &a, const std::pair<int, int> &b) { return coord(a) < coord(b); });
+        int split = coord(centroids.at(k));
+        ArcBounds bb = partitions.at(node).bb;
+        if (split < (split_x ? bb.x0 : bb.y0) || split >= (split_x ? bb.x1 : bb.y1))
+            return;
+        std::vector<std::pair<int, int>> lower, upper;
+        for (auto &c : centroids) {
+            if (coord(c) <= split)
+                lower.push_back(c);
+            else
+                upper.push_back(c);
         }
-        for (auto &p : cys) {
-            if (accum_y < halfway && (accum_y + p.second) >= halfway)
-                mid_y = p.first;
-            accum_y += p.second;
+        if (lower.empty() || upper.empty())
+            return;
+        centroids.clear();
+        centroids.shrink_to_fit();
+        partitions.at(node).split = split;
+        partitions.at(node).split_x = split_x;
+        for (int i = 0; i < 2; i++) {
+            int child = int(partitions.size());
+            partitions.emplace_back();
+            partitions.back().parent = node;
+            auto &child_bb = partitions.back().bb;
+            child_bb = bb;
+            if (split_x && i == 0)
+                child_bb.x1 = split;
+            else if (split_x)
+                child_bb.x0 = split + 1;
+            else if (i == 0)
+                child_bb.y1 = split;
+            else
+                child_bb.y0 = split + 1;
+            partitions.at(node).children[i] = child;
         }
+        bisect_partition(partitions.at(node).children[0], lower, lower_leaves);
+        bisect_partition(partitions.at(node).children[1], upper, leaves - lower_leaves);
+    }
+
+    void partition_nets()
+    {
+        std::vector<std::pair<int, int>> centroids;
+        for (auto &n : nets)
+            if (n.cx != -1 && n.cy != -1)
+                centroids.emplace_back(n.cx, n.cy);
+        partitions.clear();
+        partitions.emplace_back();
+        partitions.back().bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+        bisect_partition(0, centroids, pool.size());
         if (ctx->verbose) {
-            log_info("    x splitpoint: %d\n", mid_x);
-            log_info("    y splitpoint: %d\n", mid_y);
+            int leaves = 0;
+            for (auto &p : partitions)
+                if (p.split == -1)
+                    ++leaves;
+            log_info("    %d routing partitions (%d leaves) for %d threads\n", int(partitions.size()), leaves,
+                     pool.size());
         }
-        std::vector<int> bins(5, 0);
-        for (auto &n : nets) {
-            if (n.bb.x0 < mid_x && n.bb.x1 < mid_x && n.bb.y0 < mid_y && n.bb.y1 < mid_y)
-                ++bins[0]; // TL
-            else if (n.bb.x0 >= mid_x && n.bb.x1 >= mid_x && n.bb.y0 < mid_y && n.bb.y1 < mid_y)
-                ++bins[1]; // TR
-            else if (n.bb.x0 < mid_x && n.bb.x1 < mid_x && n.bb.y0 >= mid_y && n.bb.y1 >= mid_y)
-                ++bins[2]; // BL
-            else if (n.bb.x0 >= mid_x && n.bb.x1 >= mid_x && n.bb.y0 >= mid_y && n.bb.y1 >= mid_y)
-                ++bins[3]; // BR
+    }
+
+    // Find the deepest partition that a net can be routed in without crossing a split (plus margin)
+    int net_partition(const PerNetData &nd)
+    {
+        int node = 0;
+        while (partitions.at(node).split != -1) {
+            auto &p = partitions.at(node);
+            int lo = p.split_x ? nd.bb.x0 : nd.bb.y0, hi = p.split_x ? nd.bb.x1 : nd.bb.y1;
+            int margin = p.split_x ? cfg.bb_margin_x : cfg.bb_margin_y;
+            if (lo < (p.split - margin) && hi < (p.split - margin))
+                node = p.children[0];
+            else if (lo >= (p.split + margin) && hi >= (p.split + margin))
+                node = p.children[1];
             else
-                ++bins[4]; // cross-boundary
+                break;
         }
-        if (ctx->verbose)
-            for (int i = 0; i < 5; i++)
-                log_info("        bin %d N=%d\n", i, bins[i]);
+        return node;
     }
 
     void router_thread(ThreadContext &t, bool is_mt)
@@ -1098,112 +1602,106 @@ struct Router2
     void do_route()
     {
         // Don't multithread if fewer than 200 nets (heuristic)
-        if (route_queue.size() < 200) {
+        if (route_queue.size() < 200 || partitions.size() == 1) {
             ThreadContext st;
             st.rng.rngseed(ctx->rng64());
             st.bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+            attach_visit_slots(st, shared_visit_slot);
             for (size_t j = 0; j < route_queue.size(); j++) {
                 route_net(st, nets_by_udata[route_queue[j]], false);
             }
             return;
         }
-        const int Nq = 4, Nv = 2, Nh = 2;
-        const int N = Nq + Nv + Nh;
-        std::vector<ThreadContext> tcs(N + 1);
-        for (auto &th : tcs) {
-            th.rng.rngseed(ctx->rng64());
-        }
-        int le_x = mid_x - cfg.bb_margin_x;
-        int rs_x = mid_x + cfg.bb_margin_x;
-        int le_y = mid_y - cfg.bb_margin_y;
-        int rs_y = mid_y + cfg.bb_margin_y;
-        // Set up thread bounding boxes
-        tcs.at(0).bb = ArcBounds(0, 0, mid_x, mid_y);
-        tcs.at(1).bb = ArcBounds(mid_x + 1, 0, std::numeric_limits<int>::max(), le_y);
-        tcs.at(2).bb = ArcBounds(0, mid_y + 1, mid_x, std::numeric_limits<int>::max());
-        tcs.at(3).bb =
-                ArcBounds(mid_x + 1, mid_y + 1, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
-
-        tcs.at(4).bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), mid_y);
-        tcs.at(5).bb = ArcBounds(0, mid_y + 1, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
-
-        tcs.at(6).bb = ArcBounds(0, 0, mid_x, std::numeric_limits<int>::max());
-        tcs.at(7).bb = ArcBounds(mid_x + 1, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
-
-        tcs.at(8).bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
-
-        for (auto n : route_queue) {
-            auto &nd = nets.at(n);
-            auto ni = nets_by_udata.at(n);
-            int bin = N;
-            // Quadrants
-            if (nd.bb.x0 < le_x && nd.bb.x1 < le_x && nd.bb.y0 < le_y && nd.bb.y1 < le_y)
-                bin = 0;
-            else if (nd.bb.x0 >= rs_x && nd.bb.x1 >= rs_x && nd.bb.y0 < le_y && nd.bb.y1 < le_y)
-                bin = 1;
-            else if (nd.bb.x0 < le_x && nd.bb.x1 < le_x && nd.bb.y0 >= rs_y && nd.bb.y1 >= rs_y)
-                bin = 2;
-            else if (nd.bb.x0 >= rs_x && nd.bb.x1 >= rs_x && nd.bb.y0 >= rs_y && nd.bb.y1 >= rs_y)
-                bin = 3;
-            // Vertical split
-            else if (nd.bb.y0 < le_y && nd.bb.y1 < le_y)
-                bin = Nq + 0;
-            else if (nd.bb.y0 >= rs_y && nd.bb.y1 >= rs_y)
-                bin = Nq + 1;
-            // Horizontal split
-            else if (nd.bb.x0 < le_x && nd.bb.x1 < le_x)
-                bin = Nq + Nv + 0;
-            else if (nd.bb.x0 >= rs_x && nd.bb.x1 >= rs_x)
-                bin = Nq + Nv + 1;
-            tcs.at(bin).route_nets.push_back(ni);
+        const int N = int(partitions.size());
+        std::vector<ThreadContext> tcs(N);
+        for (int i = 0; i < N; i++) {
+            tcs.at(i).rng.rngseed(ctx->rng64());
+            tcs.at(i).bb = partitions.at(i).bb;
+            attach_visit_slots(tcs.at(i), shared_visit_slot);
         }
+        for (auto n : route_queue)
+            tcs.at(net_partition(nets.at(n))).route_nets.push_back(nets_by_udata.at(n));
         if (ctx->verbose)
-            log_info("%d/%d nets not multi-threadable\n", int(tcs.at(N).route_nets.size()), int(route_queue.size()));
-#ifdef NPNR_DISABLE_THREADS
-        // Singlethreaded routing - quadrants
-        for (int i = 0; i < Nq; i++) {
-            router_thread(tcs.at(i), /*is_mt=*/false);
-        }
-        // Vertical splits
-        for (int i = Nq; i < Nq + Nv; i++) {
-            router_thread(tcs.at(i), /*is_mt=*/false);
-        }
-        // Horizontal splits
-        for (int i = Nq + Nv; i < Nq + Nv + Nh; i++) {
-            router_thread(tcs.at(i), /*is_mt=*/false);
+            log_info("%d/%d nets not multi-threadable\n", int(tcs.at(0).route_nets.size()), int(route_queue.size()));
+        // Nets that failed in a partition (i.e. needed to leave its region) are retried by the parent, which has a
+        // larger region
+        auto add_child_failures = [&](int node) {
+            for (int c : partitions.at(node).children)
+                if (c != -1)
+                    for (auto fail : tcs.at(c).failed_nets)
+                        tcs.at(node).route_nets.push_back(fail);
+        };
+        // Number of children of each node still to be routed
+        std::vector<std::atomic<int>> pending(N);
+        std::vector<int> leaves;
+        for (int i = 0; i < N; i++) {
+            pending.at(i).store(partitions.at(i).split == -1 ? 0 : 2);
+            if (partitions.at(i).split == -1)
+                leaves.push_back(i);
         }
-#else
-        // Multithreaded part of routing - quadrants
-        std::vector<boost::thread> threads;
-        for (int i = 0; i < Nq; i++) {
-            threads.emplace_back([this, &tcs, i]() { router_thread(tcs.at(i), /*is_mt=*/true); });
+        pool.run_work_stealing(leaves, [&](int node, int, const std::function<void(int)> &spawn) {
+            add_child_failures(node);
+            router_thread(tcs.at(node), /*is_mt=*/true);
+            int parent = partitions.at(node).parent;
+            // The root partition is routed singlethreaded at the end
+            if (parent > 0 && --pending.at(parent) == 0)
+                spawn(parent);
+        });
+        add_child_failures(0);
+        if (cfg.concurrent_nets) {
+            // Nets that cross the top-level split are routed concurrently, and only those that failed to route
+            // within their bounding box are left for the singlethreaded part
+            route_concurrent(tcs.at(0).route_nets);
         }
-        for (auto &t : threads)
-            t.join();
-        threads.clear();
-        // Vertical splits
-        for (int i = Nq; i < Nq + Nv; i++) {
-            threads.emplace_back([this, &tcs, i]() { router_thread(tcs.at(i), /*is_mt=*/true); });
+        // Singlethreaded part of routing - nets that cross the top-level split
+        // or don't fit within bounding box
+        router_thread(tcs.at(0), /*is_mt=*/false);
+    }
+
+    // Route nets in parallel without restricting threads to regions, replacing route_nets with the nets that failed
+    void route_concurrent(std::vector<NetInfo *> &route_nets)
+    {
+        if (thread_visit_slot.empty()) {
+            thread_visit_slot.resize(pool.size());
+            for (auto &tv : thread_visit_slot)
+                tv.resize(shared_visit_slot.size(), -1);
         }
-        for (auto &t : threads)
-            t.join();
-        threads.clear();
-        // Horizontal splits
-        for (int i = Nq + Nv; i < Nq + Nv + Nh; i++) {
-            threads.emplace_back([this, &tcs, i]() { router_thread(tcs.at(i), /*is_mt=*/true); });
+        if (wire_locks.empty())
+            wire_locks = std::vector<std::atomic<bool>>(wire_ids.size());
+        std::vector<ThreadContext> tcs(pool.size());
+        for (int i = 0; i < pool.size(); i++) {
+            tcs.at(i).rng.rngseed(ctx->rng64());
+            tcs.at(i).bb = ArcBounds(0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+            attach_visit_slots(tcs.at(i), thread_visit_slot.at(i));
         }
-        for (auto &t : threads)
-            t.join();
-        threads.clear();
-#endif
-        // Singlethreaded part of routing - nets that cross partitions
-        // or don't fit within bounding box
-        for (auto st_net : tcs.at(N).route_nets)
-            route_net(tcs.at(N), st_net, false);
-        // Failed nets
-        for (int i = 0; i < N; i++)
-            for (auto fail : tcs.at(i).failed_nets)
-                route_net(tcs.at(N), fail, false);
+        std::atomic<size_t> next_net(0);
+        std::atomic<int> conflicts(0);
+        concurrent_routing = true;
+        pool.run_on_all([&](int thread_idx) {
+            auto &t = tcs.at(thread_idx);
+            for (size_t i = next_net++; i < route_nets.size(); i = next_net++) {
+                NetInfo *net = route_nets.at(i);
+                for (int attempt = 0;; attempt++) {
+                    t.conflict = false;
+                    if (!route_net(t, net, /*is_mt=*/true)) {
+                        t.failed_nets.push_back(net);
+                        break;
+                    }
+                    // If another net took a wire while we were routing, reroute the arcs that are now contended.
+                    // Any contention left after the last attempt is resolved by later iterations like any other
+                    if (!t.conflict || attempt >= cfg.concurrent_retries)
+                        break;
+                    ++conflicts;
+                }
+            }
+        });
+        concurrent_routing = false;
+        if (ctx->verbose)
+            log_info("    %d nets routed concurrently, %d conflicts\n", int(route_nets.size()), conflicts.load());
+        route_nets.clear();
+        for (auto &t : tcs)
+            for (auto fail : t.failed_nets)
+                route_nets.push_back(fail);
     }
 
     void operator()()
@@ -1233,7 +1731,7 @@ struct Router2
             if (timing_driven && (int(route_queue.size()) > (int(nets_by_udata.size()) / 50))) {
                 // Heuristic: reduce runtime by skipping STA in the case of a "long tail" of a few
                 // congested nodes
-                tmg.run();
+                tmg.run_incremental();
                 for (auto n : route_queue) {
                     NetInfo *ni = nets_by_udata.at(n);
                     auto &net = nets.at(n);
@@ -1254,6 +1752,8 @@ struct Router2
                     log("    routed %d/%d\n", int(j), int(route_queue.size()));
             }
 #endif
+            for (auto n : route_queue)
+                nets.at(n).tmg_dirty = true;
             do_route();
             route_queue.clear();
             update_congestion();
@@ -1266,6 +1766,12 @@ struct Router2
             if (overused_wires == 0) {
                 // Try and actually bind nextpnr Arch API wires
                 bind_and_check_all();
+                for (auto ni : nets_by_udata) {
+                    auto &nd = nets.at(ni->udata);
+                    if (nd.tmg_dirty)
+                        tmg.set_net_dirty(ni);
+                    nd.tmg_dirty = false;
+                }
             }
             for (auto cn : failed_nets)
                 route_queue.push_back(cn);
@@ -1290,6 +1796,9 @@ struct Router2
         }
         auto rend = std::chrono::high_resolution_clock::now();
         log_info("Router2 time %.02fs\n", std::chrono::duration<float>(rend - rstart).count());
+        size_t peak_rss = get_peak_rss();
+        if (peak_rss != 0)
+            log_info("Peak memory usage %.1f MiB\n", peak_rss / (1024.0 * 1024.0));
 
         log_info("Running router1 to check that route is legal...\n");
 
@@ -1319,7 +1828,12 @@ Router2Cfg::Router2Cfg(Context *ctx)
     hist_cong_weight = ctx->setting<float>("router2/histCongWeight", 1.0f);
     curr_cong_mult = ctx->setting<float>("router2/currCongWeightMult", 2.0f);
     estimate_weight = ctx->setting<float>("router2/estimateWeight", 1.75f);
+    bidirectional = ctx->setting<bool>("router2/bidirectional", false);
     perf_profile = ctx->setting<bool>("router2/perfProfile", false);
+    concurrent_nets = ctx->setting<bool>("router2/concurrentNets", false);
+    concurrent_retries = ctx->setting<int>("router2/concurrentRetries", 2);
+    if (ctx->settings.count(ctx->id("router2/reuseRouting")))
+        reuse_routing = ctx->setting<std::string>("router2/reuseRouting");
 }
 
 NEXTPNR_NAMESPACE_END
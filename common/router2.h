@@ -47,6 +47,20 @@ struct Router2Cfg
     // of choosing a less congestion/delay-optimal route
     float estimate_weight;
 
+    // Route arcs with a bidirectional A* search, from the source and the sink at the same time, instead of a
+    // forwards-only search. This usually explores far fewer wires for long arcs
+    bool bidirectional = false;
+
+    // Route the nets that cross partition boundaries concurrently, rather than on a single thread. Wire state is then
+    // protected by per-wire locks, and a net whose route was contended by a concurrently routed net is retried up to
+    // concurrent_retries times. Results are no longer reproducible between runs in this mode
+    bool concurrent_nets = false;
+    int concurrent_retries;
+
+    // JSON file written by --write from a previous run. Routing from it is reused for all arcs whose endpoints and
+    // routing resources are still valid, so that only changed parts of the design need routing again
+    std::string reuse_routing;
+
     // Print additional performance profiling information
     bool perf_profile = false;
 };
@@ -0,0 +1,190 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "thread_pool.h"
+#include <deque>
+#include "nextpnr.h"
+#include "util.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+ThreadPool::ThreadPool(int num_threads) : num_threads(std::max(num_threads, 1))
+{
+#ifdef NPNR_DISABLE_THREADS
+    this->num_threads = 1;
+#else
+    for (int i = 1; i < this->num_threads; i++)
+        workers.emplace_back([this, i]() { worker(i); });
+#endif
+}
+
+ThreadPool::~ThreadPool()
+{
+#ifndef NPNR_DISABLE_THREADS
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+    }
+    start_cv.notify_all();
+    for (auto &w : workers)
+        w.join();
+#endif
+}
+
+void ThreadPool::run_on_all(const std::function<void(int)> &func)
+{
+#ifndef NPNR_DISABLE_THREADS
+    if (num_threads > 1) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &func;
+            errors.assign(num_threads, nullptr);
+            running = num_threads - 1;
+            ++generation;
+        }
+        start_cv.notify_all();
+        try {
+            func(0);
+        } catch (...) {
+            errors.at(0) = std::current_exception();
+        }
+        // Always wait for the workers, even if the caller's share threw, as they are still using func
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [&]() { return running == 0; });
+        task = nullptr;
+        for (auto &error : errors)
+            if (error)
+                std::rethrow_exception(error);
+        return;
+    }
+#endif
+    func(0);
+}
+
+#ifndef NPNR_DISABLE_THREADS
+void ThreadPool::worker(int thread_idx)
+{
+    uint64_t seen_generation = 0;
+    while (true) {
+        const std::function<void(int)> *curr_task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_cv.wait(lock, [&]() { return shutdown || generation != seen_generation; });
+            if (shutdown)
+                return;
+            seen_generation = generation;
+            curr_task = task;
+        }
+        std::exception_ptr error;
+        try {
+            (*curr_task)(thread_idx);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            errors.at(thread_idx) = error;
+            if (--running == 0)
+                done_cv.notify_one();
+        }
+    }
+}
+#endif
+
+void ThreadPool::run_work_stealing(const std::vector<int> &initial_tasks,
+                                   const std::function<void(int, int, const std::function<void(int)> &)> &run_task)
+{
+#ifndef NPNR_DISABLE_THREADS
+    if (num_threads > 1) {
+        struct TaskDeque
+        {
+            std::mutex mutex;
+            std::deque<int> tasks;
+        };
+        std::vector<TaskDeque> deques(num_threads);
+        // Tasks queued or running; a spawned task is counted before its parent finishes, so this only reaches zero
+        // once everything is done
+        std::atomic<int> outstanding(int(initial_tasks.size()));
+        // Set if a task throws, as outstanding will then never reach zero
+        std::atomic<bool> failed(false);
+        for (size_t i = 0; i < initial_tasks.size(); i++)
+            deques.at(i % num_threads).tasks.push_back(initial_tasks.at(i));
+        run_on_all([&](int thread_idx) {
+            auto &own = deques.at(thread_idx);
+            std::function<void(int)> spawn = [&](int task) {
+                ++outstanding;
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.tasks.push_back(task);
+            };
+            while (outstanding.load() > 0 && !failed.load()) {
+                int task = -1;
+                {
+                    std::lock_guard<std::mutex> lock(own.mutex);
+                    if (!own.tasks.empty()) {
+                        task = own.tasks.back();
+                        own.tasks.pop_back();
+                    }
+                }
+                for (int i = 1; task == -1 && i < num_threads; i++) {
+                    auto &victim = deques.at((thread_idx + i) % num_threads);
+                    std::lock_guard<std::mutex> lock(victim.mutex);
+                    if (!victim.tasks.empty()) {
+                        task = victim.tasks.front();
+                        victim.tasks.pop_front();
+                    }
+                }
+                if (task == -1) {
+                    // Nothing to do until a running task spawns more work
+                    boost::this_thread::yield();
+                    continue;
+                }
+                try {
+                    run_task(task, thread_idx, spawn);
+                } catch (...) {
+                    failed = true;
+                    throw;
+                }
+                --outstanding;
+            }
+        });
+        return;
+    }
+#endif
+    std::vector<int> stack(initial_tasks.rbegin(), initial_tasks.rend());
+    std::function<void(int)> spawn = [&](int task) { stack.push_back(task); };
+    while (!stack.empty()) {
+        int task = stack.back();
+        stack.pop_back();
+        run_task(task, 0, spawn);
+    }
+}
+
+int ThreadPool::default_threads(const Context *ctx)
+{
+    int threads = int_or_default(ctx->settings, ctx->id("threads"), 0);
+#ifdef NPNR_DISABLE_THREADS
+    threads = 1;
+#else
+    if (threads <= 0)
+        threads = int(boost::thread::hardware_concurrency());
+#endif
+    return std::max(threads, 1);
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,123 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  The nextpnr Authors
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <vector>
+#ifndef NPNR_DISABLE_THREADS
+#include <boost/thread.hpp>
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#include "nextpnr_namespaces.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+struct Context;
+
+// A fixed-size pool of worker threads for data-parallel loops. The threads are started once and then reused, so that
+// loops that run many times (such as once per level of the timing graph) don't pay for thread creation every time.
+class ThreadPool
+{
+  public:
+    // num_threads includes the calling thread, so a pool of size 1 runs everything inline
+    explicit ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return num_threads; }
+
+    // Run task(thread_idx) once on every thread of the pool, including the caller as thread 0, returning once all of
+    // them have finished. If any of them throw, the exception from the lowest numbered thread is rethrown here, after
+    // the others have finished
+    void run_on_all(const std::function<void(int)> &task);
+
+    // Call func(i) for every i in [begin, end), handing out chunks of at least min_chunk iterations to the threads.
+    // Returns once all iterations are complete. The order iterations run in is unspecified, so func should only write
+    // to state owned by iteration i if the result is to be independent of the number of threads
+    template <typename Tfunc> void parallel_for(size_t begin, size_t end, Tfunc func, size_t min_chunk = 64)
+    {
+        if (end <= begin)
+            return;
+        size_t count = end - begin;
+        if (num_threads <= 1 || count <= min_chunk) {
+            for (size_t i = begin; i < end; i++)
+                func(i);
+            return;
+        }
+        size_t chunk = std::max(min_chunk, count / (size_t(num_threads) * 4));
+        std::atomic<size_t> next(begin);
+        run_on_all([&](int) {
+            while (true) {
+                size_t start = next.fetch_add(chunk);
+                if (start >= end)
+                    break;
+                size_t stop = std::min(end, start + chunk);
+                try {
+                    for (size_t i = start; i < stop; i++)
+                        func(i);
+                } catch (...) {
+                    // Stop handing out chunks; run_on_all passes the exception on
+                    next = end;
+                    throw;
+                }
+            }
+        });
+    }
+
+    // Run a dynamic set of tasks, identified by non-negative integers, with work stealing. Each thread has its own
+    // deque of tasks; it takes the most recently added task from its own deque and, when that is empty, steals the
+    // oldest task from another thread. run_task(task, thread_idx, spawn) may call spawn(new_task) to queue further
+    // tasks (for example, ones whose dependencies have just completed) on the current thread. Returns once all
+    // tasks, including spawned ones, have finished. If a task throws, no more tasks are started and the exception is
+    // rethrown here
+    void run_work_stealing(const std::vector<int> &initial_tasks,
+                           const std::function<void(int, int, const std::function<void(int)> &)> &run_task);
+
+    // Number of threads requested by the "threads" setting, or the number of hardware threads if unset or zero
+    static int default_threads(const Context *ctx);
+
+  private:
+    int num_threads;
+#ifndef NPNR_DISABLE_THREADS
+    void worker(int thread_idx);
+
+    std::vector<boost::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_cv, done_cv;
+    const std::function<void(int)> *task = nullptr;
+    // Exception thrown by each thread during the current task, if any
+    std::vector<std::exception_ptr> errors;
+    uint64_t generation = 0;
+    int running = 0;
+    bool shutdown = false;
+#endif
+};
+
+NEXTPNR_NAMESPACE_END
+
+#endif
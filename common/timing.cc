@@ -23,6 +23,7 @@
 #include <boost/range/adaptor/reversed.hpp>
 #include <deque>
 #include <map>
+#include <set>
 #include <unordered_map>
 #include <utility>
 #include "log.h"
@@ -32,6 +33,8 @@ NEXTPNR_NAMESPACE_BEGIN
 
 void TimingAnalyser::setup()
 {
+    if (!pool)
+        pool.reset(new ThreadPool(ThreadPool::default_threads(ctx)));
     init_ports();
     get_cell_delays();
     topo_sort();
@@ -45,59 +48,248 @@ void TimingAnalyser::run()
     get_route_delays();
     walk_forward();
     walk_backward();
+#ifndef NDEBUG
+    check_levelised();
+#endif
     compute_slack();
     compute_criticality();
+    have_run = true;
+    dirty_nets.clear();
+    dirty_ports.clear();
+}
+
+void TimingAnalyser::set_net_dirty(const NetInfo *net)
+{
+    if (net != nullptr)
+        dirty_nets.insert(net->name);
+}
+
+void TimingAnalyser::set_cell_dirty(const CellInfo *cell)
+{
+    for (auto &port : cell->ports) {
+        if (port.second.net == nullptr)
+            continue;
+        // Moving a driver changes every arc of the net, moving a sink only changes its own arc
+        if (port.second.type == PORT_OUT) {
+            set_net_dirty(port.second.net);
+        } else {
+            auto fnd_port = port_to_id.find(CellPortKey(cell->name, port.first));
+            if (fnd_port != port_to_id.end())
+                dirty_ports.insert(fnd_port->second);
+        }
+    }
+}
+
+void TimingAnalyser::run_incremental()
+{
+    // The incremental update needs the results of a full run, and a valid topological order to bound the cones
+    if (!have_run || have_loops) {
+        run();
+        return;
+    }
+    // Update the route delays of dirty arcs. Only arcs whose delay actually changed seed the update cones: the user
+    // port for arrival times and the net driver for required times
+    std::set<int> fwd_queue;
+    std::set<int, std::greater<int>> bwd_queue;
+    auto update_route_delay = [&](port_id_t usr) {
+        auto &pd = ports.at(usr);
+        if (pd.driver == NO_PORT)
+            return;
+        const NetInfo *ni = pd.net;
+        const PortRef &usr_ref = ni->users.at(pd.net_port.user_idx());
+        if (ni->driver.cell->bel == BelId() || usr_ref.cell->bel == BelId())
+            return;
+        DelayPair delay(ctx->getNetinfoRouteDelay(ni, usr_ref));
+        if (delay.min_delay == pd.route_delay.min_delay && delay.max_delay == pd.route_delay.max_delay)
+            return;
+        pd.route_delay = delay;
+        fwd_queue.insert(pd.topo_idx);
+        bwd_queue.insert(ports.at(pd.driver).topo_idx);
+    };
+    for (auto net_name : dirty_nets) {
+        auto fnd_net = ctx->nets.find(net_name);
+        if (fnd_net == ctx->nets.end() || fnd_net->second->driver.cell == nullptr)
+            continue;
+        auto fnd_drv = port_to_id.find(CellPortKey(fnd_net->second->driver));
+        if (fnd_drv == port_to_id.end())
+            continue;
+        for (port_id_t usr : ports.at(fnd_drv->second).users)
+            update_route_delay(usr);
+    }
+    for (port_id_t port : dirty_ports) {
+        const NetInfo *ni = ports.at(port).net;
+        if (ni != nullptr && !dirty_nets.count(ni->name))
+            update_route_delay(port);
+    }
+    dirty_nets.clear();
+    dirty_ports.clear();
+
+    // Ports whose arrival or required times changed, and therefore need slack and criticality recomputing
+    std::set<port_id_t> updated;
+    // Walk forward through the fan-out cone in topological order, stopping wherever the arrival times are unaffected
+    while (!fwd_queue.empty()) {
+        port_id_t p = topological_order.at(*fwd_queue.begin());
+        fwd_queue.erase(fwd_queue.begin());
+        if (!update_arrival(p))
+            continue;
+        updated.insert(p);
+        auto &pd = ports.at(p);
+        if (pd.type == PORT_OUT) {
+            for (port_id_t usr : pd.users)
+                fwd_queue.insert(ports.at(usr).topo_idx);
+        } else if (pd.type == PORT_IN) {
+            for (auto &fanout : pd.cell_arcs)
+                if (fanout.type == CellArc::COMBINATIONAL)
+                    fwd_queue.insert(ports.at(fanout.other).topo_idx);
+        }
+    }
+    // Likewise backwards through the fan-in cone for required times
+    while (!bwd_queue.empty()) {
+        port_id_t p = topological_order.at(*bwd_queue.begin());
+        bwd_queue.erase(bwd_queue.begin());
+        if (!update_required(p))
+            continue;
+        updated.insert(p);
+        auto &pd = ports.at(p);
+        if (pd.type == PORT_IN) {
+            if (pd.driver != NO_PORT)
+                bwd_queue.insert(ports.at(pd.driver).topo_idx);
+        } else if (pd.type == PORT_OUT) {
+            for (auto &fanin : pd.cell_arcs)
+                if (fanin.type == CellArc::COMBINATIONAL)
+                    bwd_queue.insert(ports.at(fanin.other).topo_idx);
+        }
+    }
+    if (updated.empty())
+        return;
+
+    // Update slack of the affected ports. The worst slack of a domain pair can get worse incrementally, but if the
+    // port holding the worst slack improves then a rescan is needed to find the new worst
+    std::vector<delay_t> old_worst_setup;
+    for (auto &dp : domain_pairs)
+        old_worst_setup.push_back(dp.worst_setup_slack);
+    bool rescan = false;
+    boost::container::flat_map<domain_id_t, PortDomainPairData> old_slack;
+    for (port_id_t p : updated) {
+        auto &pd = ports.at(p);
+        old_slack = pd.domain_pairs;
+        compute_port_slack(pd);
+        for (auto &pdp : pd.domain_pairs) {
+            auto &dp = domain_pairs.at(pdp.first);
+            auto &old = old_slack.at(pdp.first);
+            if (old.setup_slack == dp.worst_setup_slack && pdp.second.setup_slack > old.setup_slack)
+                rescan = true;
+            if (!setup_only && old.hold_slack == dp.worst_hold_slack && pdp.second.hold_slack > old.hold_slack)
+                rescan = true;
+            dp.worst_setup_slack = std::min(dp.worst_setup_slack, pdp.second.setup_slack);
+            if (!setup_only)
+                dp.worst_hold_slack = std::min(dp.worst_hold_slack, pdp.second.hold_slack);
+        }
+    }
+    if (rescan) {
+        for (auto &dp : domain_pairs) {
+            dp.worst_setup_slack = std::numeric_limits<delay_t>::max();
+            dp.worst_hold_slack = std::numeric_limits<delay_t>::max();
+        }
+        for (auto &pd : ports) {
+            for (auto &pdp : pd.domain_pairs) {
+                auto &dp = domain_pairs.at(pdp.first);
+                dp.worst_setup_slack = std::min(dp.worst_setup_slack, pdp.second.setup_slack);
+                if (!setup_only)
+                    dp.worst_hold_slack = std::min(dp.worst_hold_slack, pdp.second.hold_slack);
+            }
+        }
+    }
+    // Criticality is relative to the worst slack, so if that moved then every port needs updating
+    bool worst_changed = false;
+    for (size_t i = 0; i < domain_pairs.size(); i++)
+        worst_changed |= (domain_pairs.at(i).worst_setup_slack != old_worst_setup.at(i));
+    if (worst_changed) {
+        compute_criticality();
+    } else {
+        for (port_id_t p : updated)
+            compute_port_criticality(ports.at(p));
+    }
+    if (verbose_mode)
+        log_info("Incremental timing update touched %d/%d ports%s.\n", int(updated.size()), int(ports.size()),
+                 worst_changed ? " (full criticality update)" : "");
 }
 
 void TimingAnalyser::init_ports()
 {
+    ports.clear();
+    port_to_id.clear();
     // Per cell port structures
     for (auto cell : sorted(ctx->cells)) {
         CellInfo *ci = cell.second;
         for (auto port : sorted_ref(ci->ports)) {
-            auto &data = ports[CellPortKey(ci->name, port.first)];
+            CellPortKey key(ci->name, port.first);
+            port_to_id[key] = port_id_t(ports.size());
+            ports.emplace_back();
+            auto &data = ports.back();
             data.type = port.second.type;
-            data.cell_port = CellPortKey(ci->name, port.first);
+            data.cell_port = key;
+            data.net = port.second.net;
         }
     }
-    // Cell port to net port mapping
+    // Cell port to net port mapping, and routing arcs
     for (auto net : sorted(ctx->nets)) {
         NetInfo *ni = net.second;
-        if (ni->driver.cell != nullptr)
-            ports[CellPortKey(ni->driver)].net_port = NetPortKey(ni->name);
-        for (size_t i = 0; i < ni->users.size(); i++)
-            ports[CellPortKey(ni->users.at(i))].net_port = NetPortKey(ni->name, i);
+        port_id_t drv = NO_PORT;
+        if (ni->driver.cell != nullptr) {
+            drv = port_to_id.at(CellPortKey(ni->driver));
+            ports.at(drv).net_port = NetPortKey(ni->name);
+        }
+        for (size_t i = 0; i < ni->users.size(); i++) {
+            port_id_t usr = port_to_id.at(CellPortKey(ni->users.at(i)));
+            auto &usr_pd = ports.at(usr);
+            usr_pd.net_port = NetPortKey(ni->name, i);
+            if (drv != NO_PORT) {
+                usr_pd.driver = drv;
+                ports.at(drv).users.push_back(usr);
+            }
+        }
     }
 }
 
 void TimingAnalyser::get_cell_delays()
 {
-    for (auto &port : ports) {
-        CellInfo *ci = cell_info(port.first);
-        auto &pi = port_info(port.first);
-        auto &pd = port.second;
-
-        IdString name = port.first.port;
+    // Ports that take part in cell arcs at all. A combinational arc is only added when both its ports do, so that the
+    // arcs seen from the input side (used for the topological order) and the output side always match
+    std::vector<std::pair<TimingPortClass, int>> port_class(ports.size());
+    std::vector<bool> has_arcs(ports.size(), false);
+    for (port_id_t p = 0; p < port_id_t(ports.size()); p++) {
+        auto &pd = ports.at(p);
+        pd.cell_arcs.clear();
         // Ignore dangling ports altogether for timing purposes
         if (pd.net_port.net == IdString())
             continue;
-        pd.cell_arcs.clear();
-        int clkInfoCount = 0;
-        TimingPortClass cls = ctx->getPortTimingClass(ci, name, clkInfoCount);
-        if (cls == TMG_STARTPOINT || cls == TMG_ENDPOINT || cls == TMG_CLOCK_INPUT || cls == TMG_GEN_CLOCK ||
-            cls == TMG_IGNORE)
+        auto &pc = port_class.at(p);
+        pc.first = ctx->getPortTimingClass(cell_info(pd.cell_port), pd.cell_port.port, pc.second);
+        has_arcs.at(p) = !(pc.first == TMG_STARTPOINT || pc.first == TMG_ENDPOINT || pc.first == TMG_CLOCK_INPUT ||
+                           pc.first == TMG_GEN_CLOCK || pc.first == TMG_IGNORE);
+    }
+    for (port_id_t p = 0; p < port_id_t(ports.size()); p++) {
+        if (!has_arcs.at(p))
             continue;
-        if (pi.type == PORT_IN) {
+        auto &pd = ports.at(p);
+        CellInfo *ci = cell_info(pd.cell_port);
+
+        IdString name = pd.cell_port.port;
+        TimingPortClass cls = port_class.at(p).first;
+        int clkInfoCount = port_class.at(p).second;
+        if (pd.type == PORT_IN) {
             // Input ports might have setup/hold relationships
             if (cls == TMG_REGISTER_INPUT) {
                 for (int i = 0; i < clkInfoCount; i++) {
                     auto info = ctx->getPortClockingInfo(ci, name, i);
                     if (!ci->ports.count(info.clock_port) || ci->ports.at(info.clock_port).net == nullptr)
                         continue;
-                    pd.cell_arcs.emplace_back(CellArc::SETUP, info.clock_port, DelayQuad(info.setup, info.setup),
-                                              info.edge);
-                    pd.cell_arcs.emplace_back(CellArc::HOLD, info.clock_port, DelayQuad(info.hold, info.hold),
-                                              info.edge);
+                    port_id_t clock_port = port_to_id.at(CellPortKey(ci->name, info.clock_port));
+                    pd.cell_arcs.emplace_back(CellArc::SETUP, info.clock_port, clock_port,
+                                              DelayQuad(info.setup, info.setup), info.edge);
+                    pd.cell_arcs.emplace_back(CellArc::HOLD, info.clock_port, clock_port,
+                                              DelayQuad(info.hold, info.hold), info.edge);
                 }
             }
             // Combinational delays through cell
@@ -106,19 +298,24 @@ void TimingAnalyser::get_cell_delays()
                 // ignore dangling ports and non-outputs
                 if (op.net == nullptr || op.type != PORT_OUT)
                     continue;
+                port_id_t other = port_to_id.at(CellPortKey(ci->name, other_port.first));
+                if (!has_arcs.at(other))
+                    continue;
                 DelayQuad delay;
                 bool is_path = ctx->getCellDelay(ci, name, other_port.first, delay);
                 if (is_path)
-                    pd.cell_arcs.emplace_back(CellArc::COMBINATIONAL, other_port.first, delay);
+                    pd.cell_arcs.emplace_back(CellArc::COMBINATIONAL, other_port.first, other, delay);
             }
-        } else if (pi.type == PORT_OUT) {
+        } else if (pd.type == PORT_OUT) {
             // Output ports might have clk-to-q relationships
             if (cls == TMG_REGISTER_OUTPUT) {
                 for (int i = 0; i < clkInfoCount; i++) {
                     auto info = ctx->getPortClockingInfo(ci, name, i);
                     if (!ci->ports.count(info.clock_port) || ci->ports.at(info.clock_port).net == nullptr)
                         continue;
-                    pd.cell_arcs.emplace_back(CellArc::CLK_TO_Q, info.clock_port, info.clockToQ, info.edge);
+                    pd.cell_arcs.emplace_back(CellArc::CLK_TO_Q, info.clock_port,
+                                              port_to_id.at(CellPortKey(ci->name, info.clock_port)),
+                                              info.clockToQ, info.edge);
                 }
             }
             // Combinational delays through cell
@@ -127,10 +324,13 @@ void TimingAnalyser::get_cell_delays()
                 // ignore dangling ports and non-inputs
                 if (op.net == nullptr || op.type != PORT_IN)
                     continue;
+                port_id_t other = port_to_id.at(CellPortKey(ci->name, other_port.first));
+                if (!has_arcs.at(other))
+                    continue;
                 DelayQuad delay;
                 bool is_path = ctx->getCellDelay(ci, other_port.first, name, delay);
                 if (is_path)
-                    pd.cell_arcs.emplace_back(CellArc::COMBINATIONAL, other_port.first, delay);
+                    pd.cell_arcs.emplace_back(CellArc::COMBINATIONAL, other_port.first, other, delay);
             }
         }
     }
@@ -138,39 +338,35 @@ void TimingAnalyser::get_cell_delays()
 
 void TimingAnalyser::get_route_delays()
 {
-    for (auto net : sorted(ctx->nets)) {
-        NetInfo *ni = net.second;
-        if (ni->driver.cell == nullptr || ni->driver.cell->bel == BelId())
+    for (auto &pd : ports) {
+        if (pd.driver == NO_PORT)
             continue;
-        for (auto &usr : ni->users) {
-            if (usr.cell->bel == BelId())
-                continue;
-            ports.at(CellPortKey(usr)).route_delay = DelayPair(ctx->getNetinfoRouteDelay(ni, usr));
-        }
+        const NetInfo *ni = pd.net;
+        const PortRef &usr = ni->users.at(pd.net_port.user_idx());
+        if (ni->driver.cell->bel == BelId() || usr.cell->bel == BelId())
+            continue;
+        pd.route_delay = DelayPair(ctx->getNetinfoRouteDelay(ni, usr));
     }
 }
 
 void TimingAnalyser::topo_sort()
 {
-    TopoSort<CellPortKey> topo;
-    for (auto &port : ports) {
-        auto &pd = port.second;
+    TopoSort<port_id_t> topo;
+    for (port_id_t p = 0; p < port_id_t(ports.size()); p++) {
+        auto &pd = ports.at(p);
         // All ports are nodes
-        topo.node(port.first);
+        topo.node(p);
         if (pd.type == PORT_IN) {
             // inputs: combinational arcs through the cell are edges
             for (auto &arc : pd.cell_arcs) {
                 if (arc.type != CellArc::COMBINATIONAL)
                     continue;
-                topo.edge(port.first, CellPortKey(port.first.cell, arc.other_port));
+                topo.edge(p, arc.other);
             }
         } else if (pd.type == PORT_OUT) {
             // output: routing arcs are edges
-            const NetInfo *pn = port_info(port.first).net;
-            if (pn != nullptr) {
-                for (auto &usr : pn->users)
-                    topo.edge(port.first, CellPortKey(usr));
-            }
+            for (port_id_t usr : pd.users)
+                topo.edge(p, usr);
         }
     }
     bool no_loops = topo.sort();
@@ -179,14 +375,47 @@ void TimingAnalyser::topo_sort()
         int i = 0;
         for (auto &loop : topo.loops) {
             log_info("    loop %d:\n", ++i);
-            for (auto &port : loop) {
-                log_info("        %s.%s (%s)\n", ctx->nameOf(port.cell), ctx->nameOf(port.port),
-                         ctx->nameOf(port_info(port).net));
+            for (auto port : loop) {
+                auto &pd = ports.at(port);
+                log_info("        %s.%s (%s)\n", ctx->nameOf(pd.cell_port.cell), ctx->nameOf(pd.cell_port.port),
+                         ctx->nameOf(pd.net));
             }
         }
     }
     have_loops = !no_loops;
     std::swap(topological_order, topo.sorted);
+    for (int i = 0; i < int(topological_order.size()); i++)
+        ports.at(topological_order.at(i)).topo_idx = i;
+
+    level_order.clear();
+    level_start.clear();
+    if (have_loops)
+        return;
+    // Levelise the graph, so that the ports of a level only depend on ports of earlier levels and can be updated in
+    // parallel with each other
+    int max_level = 0;
+    for (auto p : topological_order) {
+        auto &pd = ports.at(p);
+        pd.level = 0;
+        if (pd.type == PORT_OUT) {
+            for (auto &fanin : pd.cell_arcs)
+                if (fanin.type == CellArc::COMBINATIONAL)
+                    pd.level = std::max(pd.level, ports.at(fanin.other).level + 1);
+        } else if (pd.type == PORT_IN && pd.driver != NO_PORT) {
+            pd.level = ports.at(pd.driver).level + 1;
+        }
+        max_level = std::max(max_level, pd.level);
+    }
+    // Counting sort by level, stable with respect to the topological order
+    level_start.resize(max_level + 2, 0);
+    for (auto &pd : ports)
+        level_start.at(pd.level + 1)++;
+    for (int i = 0; i <= max_level; i++)
+        level_start.at(i + 1) += level_start.at(i);
+    level_order.resize(topological_order.size());
+    std::vector<int> next(level_start.begin(), level_start.end() - 1);
+    for (auto p : topological_order)
+        level_order.at(next.at(ports.at(p).level)++) = p;
 }
 
 void TimingAnalyser::setup_port_domains()
@@ -201,42 +430,40 @@ void TimingAnalyser::setup_port_domains()
         updated_domains = false;
         for (auto port : topological_order) {
             auto &pd = ports.at(port);
-            auto &pi = port_info(port);
-            if (pi.type == PORT_OUT) {
+            if (pd.type == PORT_OUT) {
                 if (first_iter) {
                     for (auto &fanin : pd.cell_arcs) {
                         if (fanin.type != CellArc::CLK_TO_Q)
                             continue;
                         // registered outputs are startpoints
-                        auto dom = domain_id(port.cell, fanin.other_port, fanin.edge);
+                        auto dom = domain_id(fanin.other, fanin.edge);
+                        fanin.domain = dom;
                         // create per-domain data
                         pd.arrival[dom];
-                        domains.at(dom).startpoints.emplace_back(port, fanin.other_port);
+                        domains.at(dom).startpoints.emplace_back(port, fanin.other);
                     }
                 }
                 // copy domains across routing
-                if (pi.net != nullptr)
-                    for (auto &usr : pi.net->users)
-                        copy_domains(port, CellPortKey(usr), false);
+                for (port_id_t usr : pd.users)
+                    copy_domains(port, usr, false);
             } else {
                 // copy domains from input to output
                 for (auto &fanout : pd.cell_arcs) {
                     if (fanout.type != CellArc::COMBINATIONAL)
                         continue;
-                    copy_domains(port, CellPortKey(port.cell, fanout.other_port), false);
+                    copy_domains(port, fanout.other, false);
                 }
             }
         }
         // Go backward through the topological order (domains from the PoV of required time)
         for (auto port : reversed_range(topological_order)) {
             auto &pd = ports.at(port);
-            auto &pi = port_info(port);
-            if (pi.type == PORT_OUT) {
+            if (pd.type == PORT_OUT) {
                 // copy domains from output to input
                 for (auto &fanin : pd.cell_arcs) {
                     if (fanin.type != CellArc::COMBINATIONAL)
                         continue;
-                    copy_domains(port, CellPortKey(port.cell, fanin.other_port), true);
+                    copy_domains(port, fanin.other, true);
                 }
             } else {
                 if (first_iter) {
@@ -244,15 +471,16 @@ void TimingAnalyser::setup_port_domains()
                         if (fanout.type != CellArc::SETUP)
                             continue;
                         // registered inputs are endpoints
-                        auto dom = domain_id(port.cell, fanout.other_port, fanout.edge);
+                        auto dom = domain_id(fanout.other, fanout.edge);
+                        fanout.domain = dom;
                         // create per-domain data
                         pd.required[dom];
-                        domains.at(dom).endpoints.emplace_back(port, fanout.other_port);
+                        domains.at(dom).endpoints.emplace_back(port, fanout.other);
                     }
                 }
                 // copy port to driver
-                if (pi.net != nullptr && pi.net->driver.cell != nullptr)
-                    copy_domains(port, CellPortKey(pi.net->driver), true);
+                if (pd.driver != NO_PORT)
+                    copy_domains(port, pd.driver, true);
             }
         }
         // Iterate over ports and find domain paris
@@ -271,32 +499,32 @@ void TimingAnalyser::setup_port_domains()
 
 void TimingAnalyser::reset_times()
 {
-    for (auto &port : ports) {
-        auto do_reset = [&](std::unordered_map<domain_id_t, ArrivReqTime> &times) {
+    for (auto &pd : ports) {
+        auto do_reset = [&](domain_times_t &times) {
             for (auto &t : times) {
                 t.second.value = init_delay;
                 t.second.path_length = 0;
-                t.second.bwd_min = CellPortKey();
-                t.second.bwd_max = CellPortKey();
+                t.second.bwd_min = NO_PORT;
+                t.second.bwd_max = NO_PORT;
             }
         };
-        do_reset(port.second.arrival);
-        do_reset(port.second.required);
-        for (auto &dp : port.second.domain_pairs) {
+        do_reset(pd.arrival);
+        do_reset(pd.required);
+        for (auto &dp : pd.domain_pairs) {
             dp.second.setup_slack = std::numeric_limits<delay_t>::max();
             dp.second.hold_slack = std::numeric_limits<delay_t>::max();
             dp.second.max_path_length = 0;
             dp.second.criticality = 0;
             dp.second.budget = 0;
         }
-        port.second.worst_crit = 0;
-        port.second.worst_setup_slack = std::numeric_limits<delay_t>::max();
-        port.second.worst_hold_slack = std::numeric_limits<delay_t>::max();
+        pd.worst_crit = 0;
+        pd.worst_setup_slack = std::numeric_limits<delay_t>::max();
+        pd.worst_hold_slack = std::numeric_limits<delay_t>::max();
     }
 }
 
-void TimingAnalyser::set_arrival_time(CellPortKey target, domain_id_t domain, DelayPair arrival, int path_length,
-                                      CellPortKey prev)
+void TimingAnalyser::set_arrival_time(port_id_t target, domain_id_t domain, DelayPair arrival, int path_length,
+                                      port_id_t prev)
 {
     auto &arr = ports.at(target).arrival.at(domain);
     if (arrival.max_delay > arr.value.max_delay) {
@@ -310,8 +538,8 @@ void TimingAnalyser::set_arrival_time(CellPortKey target, domain_id_t domain, De
     arr.path_length = std::max(arr.path_length, path_length);
 }
 
-void TimingAnalyser::set_required_time(CellPortKey target, domain_id_t domain, DelayPair required, int path_length,
-                                       CellPortKey prev)
+void TimingAnalyser::set_required_time(port_id_t target, domain_id_t domain, DelayPair required, int path_length,
+                                       port_id_t prev)
 {
     auto &req = ports.at(target).required.at(domain);
     if (required.min_delay < req.value.min_delay) {
@@ -326,27 +554,25 @@ void TimingAnalyser::set_required_time(CellPortKey target, domain_id_t domain, D
 }
 
 void TimingAnalyser::walk_forward()
+{
+    if (!have_loops) {
+        // Pull arrival times level by level; each port only reads from earlier levels and writes to itself, so the
+        // result doesn't depend on the number of threads
+        for (int l = 0; l < int(level_start.size()) - 1; l++)
+            pool->parallel_for(level_start.at(l), level_start.at(l + 1),
+                               [&](size_t i) { propagate_arrival(level_order.at(i)); });
+        return;
+    }
+    walk_forward_serial();
+}
+
+void TimingAnalyser::walk_forward_serial()
 {
     // Assign initial arrival time to domain startpoints
     for (domain_id_t dom_id = 0; dom_id < domain_id_t(domains.size()); ++dom_id) {
         auto &dom = domains.at(dom_id);
-        for (auto &sp : dom.startpoints) {
-            auto &pd = ports.at(sp.first);
-            DelayPair init_arrival(0);
-            CellPortKey clock_key;
-            // TODO: clock routing delay, if analysis of that is enabled
-            if (sp.second != IdString()) {
-                // clocked startpoints have a clock-to-out time
-                for (auto &fanin : pd.cell_arcs) {
-                    if (fanin.type == CellArc::CLK_TO_Q && fanin.other_port == sp.second) {
-                        init_arrival = init_arrival + fanin.value.delayPair();
-                        break;
-                    }
-                }
-                clock_key = CellPortKey(sp.first.cell, sp.second);
-            }
-            set_arrival_time(sp.first, dom_id, init_arrival, 1, clock_key);
-        }
+        for (auto &sp : dom.startpoints)
+            set_arrival_time(sp.first, dom_id, startpoint_arrival(ports.at(sp.first), sp.second), 1, sp.second);
     }
     // Walk forward in topological order
     for (auto p : topological_order) {
@@ -354,21 +580,16 @@ void TimingAnalyser::walk_forward()
         for (auto &arr : pd.arrival) {
             if (pd.type == PORT_OUT) {
                 // Output port: propagate delay through net, adding route delay
-                NetInfo *net = port_info(p).net;
-                if (net != nullptr)
-                    for (auto &usr : net->users) {
-                        CellPortKey usr_key(usr);
-                        auto &usr_pd = ports.at(usr_key);
-                        set_arrival_time(usr_key, arr.first, arr.second.value + usr_pd.route_delay,
-                                         arr.second.path_length, p);
-                    }
+                for (port_id_t usr : pd.users)
+                    set_arrival_time(usr, arr.first, arr.second.value + ports.at(usr).route_delay,
+                                     arr.second.path_length, p);
             } else if (pd.type == PORT_IN) {
                 // Input port; propagate delay through cell, adding combinational delay
                 for (auto &fanout : pd.cell_arcs) {
                     if (fanout.type != CellArc::COMBINATIONAL)
                         continue;
-                    set_arrival_time(CellPortKey(p.cell, fanout.other_port), arr.first,
-                                     arr.second.value + fanout.value.delayPair(), arr.second.path_length + 1, p);
+                    set_arrival_time(fanout.other, arr.first, arr.second.value + fanout.value.delayPair(),
+                                     arr.second.path_length + 1, p);
                 }
             }
         }
@@ -376,29 +597,25 @@ void TimingAnalyser::walk_forward()
 }
 
 void TimingAnalyser::walk_backward()
+{
+    if (!have_loops) {
+        for (int l = int(level_start.size()) - 2; l >= 0; l--)
+            pool->parallel_for(level_start.at(l), level_start.at(l + 1),
+                               [&](size_t i) { propagate_required(level_order.at(i)); });
+        return;
+    }
+    walk_backward_serial();
+}
+
+void TimingAnalyser::walk_backward_serial()
 {
     // Assign initial required time to domain endpoints
     // Note that clock frequency will be considered later in the analysis for, for now all required times are normalised
     // to 0ns
     for (domain_id_t dom_id = 0; dom_id < domain_id_t(domains.size()); ++dom_id) {
         auto &dom = domains.at(dom_id);
-        for (auto &ep : dom.endpoints) {
-            auto &pd = ports.at(ep.first);
-            DelayPair init_setuphold(0);
-            CellPortKey clock_key;
-            // TODO: clock routing delay, if analysis of that is enabled
-            if (ep.second != IdString()) {
-                // Add setup/hold time, if this endpoint is clocked
-                for (auto &fanin : pd.cell_arcs) {
-                    if (fanin.type == CellArc::SETUP && fanin.other_port == ep.second)
-                        init_setuphold.min_delay -= fanin.value.maxDelay();
-                    if (fanin.type == CellArc::HOLD && fanin.other_port == ep.second)
-                        init_setuphold.max_delay -= fanin.value.maxDelay();
-                }
-                clock_key = CellPortKey(ep.first.cell, ep.second);
-            }
-            set_required_time(ep.first, dom_id, init_setuphold, 1, clock_key);
-        }
+        for (auto &ep : dom.endpoints)
+            set_required_time(ep.first, dom_id, endpoint_required(ports.at(ep.first), ep.second), 1, ep.second);
     }
     // Walk backwards in topological order
     for (auto p : reversed_range(topological_order)) {
@@ -406,23 +623,175 @@ void TimingAnalyser::walk_backward()
         for (auto &req : pd.required) {
             if (pd.type == PORT_IN) {
                 // Input port: propagate delay back through net, subtracting route delay
-                NetInfo *net = port_info(p).net;
-                if (net != nullptr && net->driver.cell != nullptr)
-                    set_required_time(CellPortKey(net->driver), req.first, req.second.value - pd.route_delay,
+                if (pd.driver != NO_PORT)
+                    set_required_time(pd.driver, req.first, req.second.value - pd.route_delay,
                                       req.second.path_length, p);
             } else if (pd.type == PORT_OUT) {
                 // Output port : propagate delay back through cell, subtracting combinational delay
                 for (auto &fanin : pd.cell_arcs) {
                     if (fanin.type != CellArc::COMBINATIONAL)
                         continue;
-                    set_required_time(CellPortKey(p.cell, fanin.other_port), req.first,
-                                      req.second.value - fanin.value.delayPair(), req.second.path_length + 1, p);
+                    set_required_time(fanin.other, req.first, req.second.value - fanin.value.delayPair(),
+                                      req.second.path_length + 1, p);
                 }
             }
         }
     }
 }
 
+void TimingAnalyser::check_levelised()
+{
+    if (have_loops)
+        return;
+    // Redo the walks serially, in topological order, and check the levelised walks found the same times
+    std::vector<PerPort> levelised = ports;
+    reset_times();
+    walk_forward_serial();
+    walk_backward_serial();
+    auto check_equal = [&](const domain_times_t &a, const domain_times_t &b, port_id_t p, const char *what) {
+        for (auto &t : a) {
+            auto &other = b.at(t.first);
+            if (t.second.value.min_delay != other.value.min_delay ||
+                t.second.value.max_delay != other.value.max_delay || t.second.path_length != other.path_length)
+                log_error("Levelised and serial timing analysis found different %s times for port %s.%s.\n", what,
+                          ctx->nameOf(ports.at(p).cell_port.cell), ctx->nameOf(ports.at(p).cell_port.port));
+        }
+    };
+    for (port_id_t p = 0; p < port_id_t(ports.size()); p++) {
+        check_equal(levelised.at(p).arrival, ports.at(p).arrival, p, "arrival");
+        check_equal(levelised.at(p).required, ports.at(p).required, p, "required");
+    }
+    // Keep the levelised results, so debug and release builds give the same critical paths
+    std::swap(ports, levelised);
+}
+
+DelayPair TimingAnalyser::startpoint_arrival(const PerPort &pd, port_id_t clock_port) const
+{
+    DelayPair init_arrival(0);
+    // TODO: clock routing delay, if analysis of that is enabled
+    if (clock_port != NO_PORT) {
+        // clocked startpoints have a clock-to-out time
+        for (auto &fanin : pd.cell_arcs) {
+            if (fanin.type == CellArc::CLK_TO_Q && fanin.other == clock_port) {
+                init_arrival = init_arrival + fanin.value.delayPair();
+                break;
+            }
+        }
+    }
+    return init_arrival;
+}
+
+DelayPair TimingAnalyser::endpoint_required(const PerPort &pd, port_id_t clock_port) const
+{
+    DelayPair init_setuphold(0);
+    // TODO: clock routing delay, if analysis of that is enabled
+    if (clock_port != NO_PORT) {
+        // Add setup/hold time, if this endpoint is clocked
+        for (auto &fanin : pd.cell_arcs) {
+            if (fanin.type == CellArc::SETUP && fanin.other == clock_port)
+                init_setuphold.min_delay -= fanin.value.maxDelay();
+            if (fanin.type == CellArc::HOLD && fanin.other == clock_port)
+                init_setuphold.max_delay -= fanin.value.maxDelay();
+        }
+    }
+    return init_setuphold;
+}
+
+bool TimingAnalyser::times_equal(const domain_times_t &a, const domain_times_t &b)
+{
+    for (auto &t : a) {
+        auto &other = b.at(t.first);
+        if (t.second.value.min_delay != other.value.min_delay || t.second.value.max_delay != other.value.max_delay ||
+            t.second.path_length != other.path_length)
+            return false;
+    }
+    return true;
+}
+
+bool TimingAnalyser::update_arrival(port_id_t port)
+{
+    auto &pd = ports.at(port);
+    auto old_arrival = pd.arrival;
+    propagate_arrival(port);
+    return !times_equal(pd.arrival, old_arrival);
+}
+
+void TimingAnalyser::propagate_arrival(port_id_t port)
+{
+    auto &pd = ports.at(port);
+    for (auto &arr : pd.arrival) {
+        arr.second.value = init_delay;
+        arr.second.path_length = 0;
+        arr.second.bwd_min = NO_PORT;
+        arr.second.bwd_max = NO_PORT;
+    }
+    if (pd.type == PORT_OUT) {
+        // Registered outputs are startpoints
+        for (auto &fanin : pd.cell_arcs) {
+            if (fanin.type != CellArc::CLK_TO_Q)
+                continue;
+            set_arrival_time(port, fanin.domain, startpoint_arrival(pd, fanin.other), 1, fanin.other);
+        }
+        // Combinational arcs through the cell
+        for (auto &fanin : pd.cell_arcs) {
+            if (fanin.type != CellArc::COMBINATIONAL)
+                continue;
+            for (auto &arr : ports.at(fanin.other).arrival)
+                set_arrival_time(port, arr.first, arr.second.value + fanin.value.delayPair(),
+                                 arr.second.path_length + 1, fanin.other);
+        }
+    } else if (pd.type == PORT_IN) {
+        // Routing from the net driver
+        if (pd.driver != NO_PORT)
+            for (auto &arr : ports.at(pd.driver).arrival)
+                set_arrival_time(port, arr.first, arr.second.value + pd.route_delay, arr.second.path_length,
+                                 pd.driver);
+    }
+}
+
+bool TimingAnalyser::update_required(port_id_t port)
+{
+    auto &pd = ports.at(port);
+    auto old_required = pd.required;
+    propagate_required(port);
+    return !times_equal(pd.required, old_required);
+}
+
+void TimingAnalyser::propagate_required(port_id_t port)
+{
+    auto &pd = ports.at(port);
+    for (auto &req : pd.required) {
+        req.second.value = init_delay;
+        req.second.path_length = 0;
+        req.second.bwd_min = NO_PORT;
+        req.second.bwd_max = NO_PORT;
+    }
+    if (pd.type == PORT_IN) {
+        // Registered inputs are endpoints
+        for (auto &fanout : pd.cell_arcs) {
+            if (fanout.type != CellArc::SETUP)
+                continue;
+            set_required_time(port, fanout.domain, endpoint_required(pd, fanout.other), 1, fanout.other);
+        }
+        // Combinational arcs through the cell
+        for (auto &fanout : pd.cell_arcs) {
+            if (fanout.type != CellArc::COMBINATIONAL)
+                continue;
+            for (auto &req : ports.at(fanout.other).required)
+                set_required_time(port, req.first, req.second.value - fanout.value.delayPair(),
+                                  req.second.path_length + 1, fanout.other);
+        }
+    } else if (pd.type == PORT_OUT) {
+        // Routing to the net users
+        for (port_id_t usr : pd.users) {
+            auto &usr_pd = ports.at(usr);
+            for (auto &req : usr_pd.required)
+                set_required_time(port, req.first, req.second.value - usr_pd.route_delay, req.second.path_length,
+                                  usr);
+        }
+    }
+}
+
 void TimingAnalyser::print_fmax()
 {
     // Temporary testing code for comparison only
@@ -449,50 +818,62 @@ void TimingAnalyser::compute_slack()
         dp.worst_setup_slack = std::numeric_limits<delay_t>::max();
         dp.worst_hold_slack = std::numeric_limits<delay_t>::max();
     }
-    for (auto p : topological_order) {
-        auto &pd = ports.at(p);
+    pool->parallel_for(0, ports.size(), [&](size_t i) { compute_port_slack(ports.at(i)); });
+    for (auto &pd : ports) {
         for (auto &pdp : pd.domain_pairs) {
             auto &dp = domain_pairs.at(pdp.first);
-            auto &arr = pd.arrival.at(dp.key.launch);
-            auto &req = pd.required.at(dp.key.capture);
-            pdp.second.setup_slack = dp.period.minDelay() - (arr.value.maxDelay() - req.value.minDelay());
-            if (!setup_only)
-                pdp.second.hold_slack = arr.value.minDelay() - req.value.maxDelay();
-            pdp.second.max_path_length = arr.path_length + req.path_length;
-            pd.worst_setup_slack = std::min(pd.worst_setup_slack, pdp.second.setup_slack);
             dp.worst_setup_slack = std::min(dp.worst_setup_slack, pdp.second.setup_slack);
-            if (!setup_only) {
-                pd.worst_hold_slack = std::min(pd.worst_hold_slack, pdp.second.hold_slack);
+            if (!setup_only)
                 dp.worst_hold_slack = std::min(dp.worst_hold_slack, pdp.second.hold_slack);
-            }
         }
     }
 }
 
+void TimingAnalyser::compute_port_slack(PerPort &pd)
+{
+    pd.worst_setup_slack = std::numeric_limits<delay_t>::max();
+    pd.worst_hold_slack = std::numeric_limits<delay_t>::max();
+    for (auto &pdp : pd.domain_pairs) {
+        auto &dp = domain_pairs.at(pdp.first);
+        auto &arr = pd.arrival.at(dp.key.launch);
+        auto &req = pd.required.at(dp.key.capture);
+        pdp.second.setup_slack = dp.period.minDelay() - (arr.value.maxDelay() - req.value.minDelay());
+        if (!setup_only)
+            pdp.second.hold_slack = arr.value.minDelay() - req.value.maxDelay();
+        pdp.second.max_path_length = arr.path_length + req.path_length;
+        pd.worst_setup_slack = std::min(pd.worst_setup_slack, pdp.second.setup_slack);
+        if (!setup_only)
+            pd.worst_hold_slack = std::min(pd.worst_hold_slack, pdp.second.hold_slack);
+    }
+}
+
 void TimingAnalyser::compute_criticality()
 {
-    for (auto p : topological_order) {
-        auto &pd = ports.at(p);
-        for (auto &pdp : pd.domain_pairs) {
-            auto &dp = domain_pairs.at(pdp.first);
-            float crit =
-                    1.0f - (float(pdp.second.setup_slack) - float(dp.worst_setup_slack)) / float(-dp.worst_setup_slack);
-            crit = std::min(crit, 1.0f);
-            crit = std::max(crit, 0.0f);
-            pdp.second.criticality = crit;
-            pd.worst_crit = std::max(pd.worst_crit, crit);
-        }
+    pool->parallel_for(0, ports.size(), [&](size_t i) { compute_port_criticality(ports.at(i)); });
+}
+
+void TimingAnalyser::compute_port_criticality(PerPort &pd)
+{
+    pd.worst_crit = 0;
+    for (auto &pdp : pd.domain_pairs) {
+        auto &dp = domain_pairs.at(pdp.first);
+        float crit =
+                1.0f - (float(pdp.second.setup_slack) - float(dp.worst_setup_slack)) / float(-dp.worst_setup_slack);
+        crit = std::min(crit, 1.0f);
+        crit = std::max(crit, 0.0f);
+        pdp.second.criticality = crit;
+        pd.worst_crit = std::max(pd.worst_crit, crit);
     }
 }
 
-std::vector<CellPortKey> TimingAnalyser::get_failing_eps(domain_id_t domain_pair, int count)
+std::vector<TimingAnalyser::port_id_t> TimingAnalyser::get_failing_eps(domain_id_t domain_pair, int count)
 {
-    std::vector<CellPortKey> failing_eps;
+    std::vector<port_id_t> failing_eps;
     delay_t last_slack = std::numeric_limits<delay_t>::min();
     auto &dp = domain_pairs.at(domain_pair);
     auto &cap_d = domains.at(dp.key.capture);
     while (int(failing_eps.size()) < count) {
-        CellPortKey next;
+        port_id_t next = NO_PORT;
         delay_t next_slack = std::numeric_limits<delay_t>::max();
         for (auto ep : cap_d.endpoints) {
             auto &pd = ports.at(ep.first);
@@ -504,7 +885,7 @@ std::vector<CellPortKey> TimingAnalyser::get_failing_eps(domain_id_t domain_pair
                 next_slack = ep_slack;
             }
         }
-        if (next == CellPortKey())
+        if (next == NO_PORT)
             break;
         failing_eps.push_back(next);
         last_slack = next_slack;
@@ -512,18 +893,20 @@ std::vector<CellPortKey> TimingAnalyser::get_failing_eps(domain_id_t domain_pair
     return failing_eps;
 }
 
-void TimingAnalyser::print_critical_path(CellPortKey endpoint, domain_id_t domain_pair)
+void TimingAnalyser::print_critical_path(port_id_t endpoint, domain_id_t domain_pair)
 {
-    CellPortKey cursor = endpoint;
+    port_id_t cursor = endpoint;
     auto &dp = domain_pairs.at(domain_pair);
-    log("    endpoint %s.%s (slack %.02fns):\n", ctx->nameOf(cursor.cell), ctx->nameOf(cursor.port),
+    log("    endpoint %s.%s (slack %.02fns):\n", ctx->nameOf(ports.at(cursor).cell_port.cell),
+        ctx->nameOf(ports.at(cursor).cell_port.port),
         ctx->getDelayNS(ports.at(cursor).domain_pairs.at(domain_pair).setup_slack));
-    while (cursor != CellPortKey()) {
-        log("        %s.%s (net %s)\n", ctx->nameOf(cursor.cell), ctx->nameOf(cursor.port),
-            ctx->nameOf(get_net_or_empty(ctx->cells.at(cursor.cell).get(), cursor.port)));
-        if (!ports.at(cursor).arrival.count(dp.key.launch))
+    while (cursor != NO_PORT) {
+        auto &pd = ports.at(cursor);
+        log("        %s.%s (net %s)\n", ctx->nameOf(pd.cell_port.cell), ctx->nameOf(pd.cell_port.port),
+            ctx->nameOf(pd.net));
+        if (!pd.arrival.count(dp.key.launch))
             break;
-        cursor = ports.at(cursor).arrival.at(dp.key.launch).bwd_max;
+        cursor = pd.arrival.at(dp.key.launch).bwd_max;
     }
 }
 
@@ -546,9 +929,9 @@ void TimingAnalyser::print_report()
     }
 }
 
-domain_id_t TimingAnalyser::domain_id(IdString cell, IdString clock_port, ClockEdge edge)
+domain_id_t TimingAnalyser::domain_id(port_id_t clock_port, ClockEdge edge)
 {
-    return domain_id(ctx->cells.at(cell)->ports.at(clock_port).net, edge);
+    return domain_id(ports.at(clock_port).net, edge);
 }
 domain_id_t TimingAnalyser::domain_id(const NetInfo *net, ClockEdge edge)
 {
@@ -570,7 +953,7 @@ domain_id_t TimingAnalyser::domain_pair_id(domain_id_t launch, domain_id_t captu
     return inserted.first->second;
 }
 
-void TimingAnalyser::copy_domains(const CellPortKey &from, const CellPortKey &to, bool backward)
+void TimingAnalyser::copy_domains(port_id_t from, port_id_t to, bool backward)
 {
     auto &f = ports.at(from), &t = ports.at(to);
     for (auto &dom : (backward ? f.required : f.arrival)) {
@@ -580,8 +963,6 @@ void TimingAnalyser::copy_domains(const CellPortKey &from, const CellPortKey &to
 
 CellInfo *TimingAnalyser::cell_info(const CellPortKey &key) { return ctx->cells.at(key.cell).get(); }
 
-PortInfo &TimingAnalyser::port_info(const CellPortKey &key) { return ctx->cells.at(key.cell)->ports.at(key.port); }
-
 /** LEGACY CODE BEGIN **/
 
 namespace {
@@ -20,7 +20,9 @@
 #ifndef TIMING_H
 #define TIMING_H
 
+#include <boost/container/flat_map.hpp>
 #include "nextpnr.h"
+#include "thread_pool.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -130,12 +132,19 @@ struct TimingAnalyser
     void run();
     void print_report();
 
-    float get_criticality(CellPortKey port) const { return ports.at(port).worst_crit; }
-    float get_setup_slack(CellPortKey port) const { return ports.at(port).worst_setup_slack; }
+    // Incremental analysis: callers mark the nets (rerouted) or cells (moved) that changed since the last run, then
+    // run_incremental() only re-propagates the fan-out/fan-in cones of arcs whose route delay actually changed.
+    // Changes to the netlist structure itself still require a call to setup()
+    void set_net_dirty(const NetInfo *net);
+    void set_cell_dirty(const CellInfo *cell);
+    void run_incremental();
+
+    float get_criticality(CellPortKey port) const { return ports.at(port_to_id.at(port)).worst_crit; }
+    float get_setup_slack(CellPortKey port) const { return ports.at(port_to_id.at(port)).worst_setup_slack; }
     float get_domain_setup_slack(CellPortKey port) const
     {
         delay_t slack = std::numeric_limits<delay_t>::max();
-        for (const auto &dp : ports.at(port).domain_pairs)
+        for (const auto &dp : ports.at(port_to_id.at(port)).domain_pairs)
             slack = std::min(slack, domain_pairs.at(dp.first).worst_setup_slack);
         return slack;
     }
@@ -146,6 +155,11 @@ struct TimingAnalyser
     bool updated_domains = false;
 
   private:
+    // Ports are assigned a dense index at setup time; all internal timing graph traversal uses these rather than
+    // CellPortKey lookups
+    typedef int port_id_t;
+    static const port_id_t NO_PORT = -1;
+
     void init_ports();
     void get_cell_delays();
     void get_route_delays();
@@ -156,23 +170,36 @@ struct TimingAnalyser
 
     void walk_forward();
     void walk_backward();
+    // Push-based walks in topological order, used when the graph has loops and so can't be levelised
+    void walk_forward_serial();
+    void walk_backward_serial();
+    // Debug check that the levelised walks give the same times as the serial ones
+    void check_levelised();
 
     void compute_slack();
     void compute_criticality();
 
+    // Recompute the arrival/required times of a single port from its fan-in/fan-out, returning true if they changed
+    bool update_arrival(port_id_t port);
+    bool update_required(port_id_t port);
+    // As above, but without the change detection. These only write to the given port, so all the ports in a level
+    // can be processed concurrently
+    void propagate_arrival(port_id_t port);
+    void propagate_required(port_id_t port);
+
     void print_fmax();
     // get the N most failing endpoints for a given domain pair
-    std::vector<CellPortKey> get_failing_eps(domain_id_t domain_pair, int count);
+    std::vector<port_id_t> get_failing_eps(domain_id_t domain_pair, int count);
     // print the critical path for an endpoint and domain pair
-    void print_critical_path(CellPortKey endpoint, domain_id_t domain_pair);
+    void print_critical_path(port_id_t endpoint, domain_id_t domain_pair);
 
     const DelayPair init_delay{std::numeric_limits<delay_t>::max(), std::numeric_limits<delay_t>::lowest()};
 
     // Set arrival/required times if more/less than the current value
-    void set_arrival_time(CellPortKey target, domain_id_t domain, DelayPair arrival, int path_length,
-                          CellPortKey prev = CellPortKey());
-    void set_required_time(CellPortKey target, domain_id_t domain, DelayPair required, int path_length,
-                           CellPortKey prev = CellPortKey());
+    void set_arrival_time(port_id_t target, domain_id_t domain, DelayPair arrival, int path_length,
+                          port_id_t prev = NO_PORT);
+    void set_required_time(port_id_t target, domain_id_t domain, DelayPair required, int path_length,
+                           port_id_t prev = NO_PORT);
 
     // To avoid storing the domain tag structure (which could get large when considering more complex constrained tag
     // cases), assign each domain an ID and use that instead
@@ -181,8 +208,8 @@ struct TimingAnalyser
     struct ArrivReqTime
     {
         DelayPair value;
-        CellPortKey bwd_min, bwd_max;
-        int path_length;
+        port_id_t bwd_min = NO_PORT, bwd_max = NO_PORT;
+        int path_length = 0;
     };
     // Data per port-domain tuple
     struct PortDomainPairData
@@ -193,6 +220,11 @@ struct TimingAnalyser
         float criticality = 0;
     };
 
+    // Most ports only see a handful of domains, so these are stored as sorted vectors rather than hash maps
+    typedef boost::container::flat_map<domain_id_t, ArrivReqTime> domain_times_t;
+
+    static bool times_equal(const domain_times_t &a, const domain_times_t &b);
+
     // A cell timing arc, used to cache cell timings and reduce the number of potentially-expensive Arch API calls
     struct CellArc
     {
@@ -206,14 +238,18 @@ struct TimingAnalyser
         } type;
 
         IdString other_port;
+        port_id_t other;
         DelayQuad value;
         // Clock polarity, not used for combinational arcs
         ClockEdge edge;
-
-        CellArc(ArcType type, IdString other_port, DelayQuad value)
-                : type(type), other_port(other_port), value(value), edge(RISING_EDGE){};
-        CellArc(ArcType type, IdString other_port, DelayQuad value, ClockEdge edge)
-                : type(type), other_port(other_port), value(value), edge(edge){};
+        // Clock domain of startpoint (CLK_TO_Q) and endpoint (SETUP) arcs, resolved once by setup_port_domains so
+        // that propagation never needs to look domains up
+        domain_id_t domain = -1;
+
+        CellArc(ArcType type, IdString other_port, port_id_t other, DelayQuad value)
+                : type(type), other_port(other_port), other(other), value(value), edge(RISING_EDGE){};
+        CellArc(ArcType type, IdString other_port, port_id_t other, DelayQuad value, ClockEdge edge)
+                : type(type), other_port(other_port), other(other), value(value), edge(edge){};
     };
 
     // Timing data for every cell port
@@ -222,17 +258,26 @@ struct TimingAnalyser
         CellPortKey cell_port;
         NetPortKey net_port;
         PortType type;
+        // net connected to this port, or nullptr if dangling
+        NetInfo *net = nullptr;
         // per domain timings
-        std::unordered_map<domain_id_t, ArrivReqTime> arrival;
-        std::unordered_map<domain_id_t, ArrivReqTime> required;
-        std::unordered_map<domain_id_t, PortDomainPairData> domain_pairs;
+        domain_times_t arrival;
+        domain_times_t required;
+        boost::container::flat_map<domain_id_t, PortDomainPairData> domain_pairs;
         // cell timing arcs to (outputs)/from (inputs)  from this port
         std::vector<CellArc> cell_arcs;
+        // routing arcs from the net driver (input ports only) or to the net users (output ports only)
+        port_id_t driver = NO_PORT;
+        std::vector<port_id_t> users;
         // routing delay into this port (input ports only)
         DelayPair route_delay;
         // worst criticality and slack across domain pairs
         float worst_crit;
         delay_t worst_setup_slack, worst_hold_slack;
+        // index into topological_order
+        int topo_idx = -1;
+        // longest number of arcs from a timing graph source; all fan-in of a port is at a strictly lower level
+        int level = 0;
     };
 
     struct PerDomain
@@ -240,33 +285,50 @@ struct TimingAnalyser
         PerDomain(ClockDomainKey key) : key(key){};
         ClockDomainKey key;
         // these are pairs (signal port; clock port)
-        std::vector<std::pair<CellPortKey, IdString>> startpoints, endpoints;
+        std::vector<std::pair<port_id_t, port_id_t>> startpoints, endpoints;
     };
 
     struct PerDomainPair
     {
-        PerDomainPair(ClockDomainPairKey key) : key(key){};
+        PerDomainPair(ClockDomainPairKey key) : key(key), period(0){};
         ClockDomainPairKey key;
         DelayPair period;
         delay_t worst_setup_slack, worst_hold_slack;
     };
 
     CellInfo *cell_info(const CellPortKey &key);
-    PortInfo &port_info(const CellPortKey &key);
 
-    domain_id_t domain_id(IdString cell, IdString clock_port, ClockEdge edge);
+    domain_id_t domain_id(port_id_t clock_port, ClockEdge edge);
     domain_id_t domain_id(const NetInfo *net, ClockEdge edge);
     domain_id_t domain_pair_id(domain_id_t launch, domain_id_t capture);
 
-    void copy_domains(const CellPortKey &from, const CellPortKey &to, bool backwards);
+    void copy_domains(port_id_t from, port_id_t to, bool backwards);
+
+    DelayPair startpoint_arrival(const PerPort &pd, port_id_t clock_port) const;
+    DelayPair endpoint_required(const PerPort &pd, port_id_t clock_port) const;
+
+    void compute_port_slack(PerPort &pd);
+    void compute_port_criticality(PerPort &pd);
 
-    std::unordered_map<CellPortKey, PerPort, CellPortKey::Hash> ports;
+    std::vector<PerPort> ports;
+    std::unordered_map<CellPortKey, port_id_t, CellPortKey::Hash> port_to_id;
     std::unordered_map<ClockDomainKey, domain_id_t, ClockDomainKey::Hash> domain_to_id;
     std::unordered_map<ClockDomainPairKey, domain_id_t, ClockDomainPairKey::Hash> pair_to_id;
     std::vector<PerDomain> domains;
     std::vector<PerDomainPair> domain_pairs;
 
-    std::vector<CellPortKey> topological_order;
+    std::vector<port_id_t> topological_order;
+    // Ports bucketed by level (only built when there are no loops); ports in level i are
+    // level_order[level_start[i]..level_start[i+1])
+    std::vector<port_id_t> level_order;
+    std::vector<int> level_start;
+
+    std::unique_ptr<ThreadPool> pool;
+
+    // State for incremental updates
+    bool have_run = false;
+    std::unordered_set<IdString> dirty_nets;
+    std::unordered_set<port_id_t> dirty_ports;
 
     Context *ctx;
 };
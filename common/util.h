@@ -23,6 +23,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 #include "nextpnr.h"
 
 #include "log.h"
@@ -112,6 +113,20 @@ template <typename K, typename V> std::map<K, V *> sorted(const std::unordered_m
     return retVal;
 };
 
+// Wrap a CachedOrderMap, and allow it to be iterated over sorted by key. This is a snapshot, so the map may be
+// modified while iterating over it; but the key order is cached by the map, so only needs sorting again after
+// insertions or erasures
+template <typename K, typename V>
+std::vector<std::pair<K, V *>> sorted(const CachedOrderMap<K, std::unique_ptr<V>> &orig)
+{
+    std::vector<std::pair<K, V *>> retVal;
+    const auto &order = orig.sorted_entries();
+    retVal.reserve(order.size());
+    for (auto item : order)
+        retVal.emplace_back(item->first, item->second.get());
+    return retVal;
+};
+
 // Wrap an unordered_map, and allow it to be iterated over sorted by key
 template <typename K, typename V> std::map<K, V &> sorted_ref(std::unordered_map<K, V> &orig)
 {
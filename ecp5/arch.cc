@@ -105,6 +105,12 @@ Arch::Arch(ArchArgs args) : args(args)
 
     bel_to_cell.resize(chip_info->height * chip_info->width * max_loc_bels, nullptr);
 
+    loc_wire_index_base.reserve(chip_info->height * chip_info->width);
+    for (int i = 0; i < chip_info->height * chip_info->width; i++) {
+        loc_wire_index_base.push_back(wire_index_count);
+        wire_index_count += chip_info->locations[chip_info->location_type[i]].wire_data.ssize();
+    }
+
     BaseArch::init_cell_types();
     BaseArch::init_bel_buckets();
 
@@ -426,6 +432,20 @@ BelId Arch::getBelByLocation(Loc loc) const
 
 // -----------------------------------------------------------------------
 
+void Arch::init_delay_lookahead()
+{
+    if (!DelayLookahead::enabled(getCtx()))
+        return;
+    wire_lookahead_class.resize(chip_info->locations.size());
+    for (int lt = 0; lt < chip_info->locations.ssize(); lt++) {
+        auto &wires = chip_info->locations[lt].wire_data;
+        for (int i = 0; i < wires.ssize(); i++)
+            wire_lookahead_class[lt].push_back(delay_lookahead.class_of(wires[i].name.get()));
+    }
+    delay_lookahead.init(getCtx(), stringf("ecp5-%s", archArgsToId(args).c_str(this)),
+                         [this](WireId wire) { return lookahead_wire(wire); });
+}
+
 delay_t Arch::estimateDelay(WireId src, WireId dst) const
 {
     int num_uh = loc_info(dst)->wire_data[dst.index].pips_uphill.size();
@@ -436,6 +456,12 @@ delay_t Arch::estimateDelay(WireId src, WireId dst) const
         }
     }
 
+    if (delay_lookahead.ready() && !wire_loc_overrides.count(dst)) {
+        delay_t v = delay_lookahead.estimate(lookahead_wire(src), lookahead_wire(dst));
+        if (v >= 0)
+            return v;
+    }
+
     auto est_location = [&](WireId w) -> std::pair<int, int> {
         const auto &wire = loc_info(w)->wire_data[w.index];
         if (w == gsrclk_wire) {
@@ -602,6 +628,7 @@ bool Arch::route()
     setup_wire_locations();
     route_ecp5_globals(getCtx());
     assignArchInfo();
+    init_delay_lookahead();
     assign_budget(getCtx(), true);
 
     bool result;
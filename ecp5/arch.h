@@ -25,6 +25,7 @@
 #include <sstream>
 
 #include "base_arch.h"
+#include "delay_lookahead.h"
 #include "nextpnr_types.h"
 #include "relptr.h"
 
@@ -463,6 +464,10 @@ struct Arch : BaseArch<ArchRanges>
     std::vector<CellInfo *> bel_to_cell;
     std::unordered_map<WireId, int> wire_fanout;
 
+    // Dense wire index of the first wire at each location, indexed by y * width + x
+    std::vector<int> loc_wire_index_base;
+    int wire_index_count = 0;
+
     // fast access to  X and Y IdStrings for building object names
     std::vector<IdString> x_ids, y_ids;
     // inverse of the above for name->object mapping
@@ -627,6 +632,11 @@ struct Arch : BaseArch<ArchRanges>
     std::vector<std::pair<IdString, std::string>> getWireAttrs(WireId) const override;
 
     uint32_t getWireChecksum(WireId wire) const override { return wire.index; }
+    int getWireIndexCount() const override { return wire_index_count; }
+    int getWireIndex(WireId wire) const override
+    {
+        return loc_wire_index_base[wire.location.y * chip_info->width + wire.location.x] + wire.index;
+    }
 
     void unbindWire(WireId wire) override
     {
@@ -819,6 +829,21 @@ struct Arch : BaseArch<ArchRanges>
     uint32_t getDelayChecksum(delay_t v) const override { return v; }
     bool getBudgetOverride(const NetInfo *net_info, const PortRef &sink, delay_t &budget) const override;
 
+    // Sampled routing delays used by estimateDelay, if enabled; wire classes are indexed by location type then wire
+    DelayLookahead delay_lookahead;
+    std::vector<std::vector<int>> wire_lookahead_class;
+    void init_delay_lookahead();
+    LookaheadWire lookahead_wire(WireId wire) const
+    {
+        LookaheadWire lw;
+        lw.cls = wire_lookahead_class.at(chip_info->location_type[wire.location.y * chip_info->width +
+                                                                  wire.location.x])
+                         .at(wire.index);
+        lw.x = wire.location.x;
+        lw.y = wire.location.y;
+        return lw;
+    }
+
     // -------------------------------------------------
 
     bool pack() override;
@@ -853,6 +878,8 @@ struct Arch : BaseArch<ArchRanges>
     // -------------------------------------------------
     // Placement validity checks
     bool isBelLocationValid(BelId bel) const override;
+    // Binding only touches bel_to_cell, and validity only depends on the cells in the bel's tile
+    bool isBelBindLocal(BelId bel) const override { return true; }
 
     // Helper function for above
     bool slices_compatible(const std::vector<const CellInfo *> &cells) const;
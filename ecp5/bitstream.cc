@@ -26,8 +26,10 @@
 #include <regex>
 #include <streambuf>
 #include "config.h"
+#include "design_utils.h"
 #include "log.h"
 #include "pio.h"
+#include "thread_pool.h"
 #include "util.h"
 
 #define fmt_str(x) (static_cast<const std::ostringstream &>(std::ostringstream() << x).str())
@@ -514,12 +516,19 @@ void tieoff_dcu_ports(Context *ctx, ChipConfig &cc, CellInfo *ci)
     }
 }
 
-static void set_pip(Context *ctx, ChipConfig &cc, PipId pip)
+// A routing arc, and the tile it is set in
+struct PipArc
 {
-    std::string tile = ctx->get_pip_tilename(pip);
-    std::string source = get_trellis_wirename(ctx, pip.location, ctx->getPipSrcWire(pip));
-    std::string sink = get_trellis_wirename(ctx, pip.location, ctx->getPipDstWire(pip));
-    cc.tiles[tile].add_arc(sink, source);
+    std::string tile, sink, source;
+};
+
+static PipArc get_pip_arc(Context *ctx, PipId pip)
+{
+    PipArc arc;
+    arc.tile = ctx->get_pip_tilename(pip);
+    arc.source = get_trellis_wirename(ctx, pip.location, ctx->getPipSrcWire(pip));
+    arc.sink = get_trellis_wirename(ctx, pip.location, ctx->getPipDstWire(pip));
+    return arc;
 }
 
 static std::vector<bool> parse_config_str(const Property &p, int length)
@@ -652,21 +661,37 @@ void write_bitstream(Context *ctx, std::string base_config_file, std::string tex
             }
         }
     }
-    // Add all set, configurable pips to the config
-    for (auto pip : ctx->getPips()) {
-        if (ctx->getBoundPipNet(pip) != nullptr) {
-            if (ctx->get_pip_class(pip) == 0) { // ignore fixed pips
-                std::string source = get_trellis_wirename(ctx, pip.location, ctx->getPipSrcWire(pip));
-                if (source.find("CLKI_PLL") != std::string::npos) {
-                    // Special case - must set pip in all relevant tiles
-                    for (auto equiv_pip : ctx->getPipsUphill(ctx->getPipDstWire(pip))) {
-                        if (ctx->getPipSrcWire(equiv_pip) == ctx->getPipSrcWire(pip))
-                            set_pip(ctx, cc, equiv_pip);
-                    }
-                } else {
-                    set_pip(ctx, cc, pip);
+    // Add all set, configurable pips to the config, in the same order as getPips. Naming the arcs is most of the work,
+    // so is done on several threads first; the arcs are then added to their tiles in order
+    std::vector<PipId> bound_pips = get_bound_pips(ctx);
+    std::sort(bound_pips.begin(), bound_pips.end());
+    std::vector<std::vector<PipArc>> pip_arcs(bound_pips.size());
+    ThreadPool pool(ThreadPool::default_threads(ctx));
+    pool.parallel_for(0, bound_pips.size(), [&](size_t i) {
+        PipId pip = bound_pips.at(i);
+        if (ctx->get_pip_class(pip) == 0) { // ignore fixed pips
+            std::string source = get_trellis_wirename(ctx, pip.location, ctx->getPipSrcWire(pip));
+            if (source.find("CLKI_PLL") != std::string::npos) {
+                // Special case - must set pip in all relevant tiles
+                for (auto equiv_pip : ctx->getPipsUphill(ctx->getPipDstWire(pip))) {
+                    if (ctx->getPipSrcWire(equiv_pip) == ctx->getPipSrcWire(pip))
+                        pip_arcs.at(i).push_back(get_pip_arc(ctx, equiv_pip));
                 }
+            } else {
+                pip_arcs.at(i).push_back(get_pip_arc(ctx, pip));
+            }
+        }
+    });
+    TileConfig *last_tile = nullptr;
+    std::string last_tile_name;
+    for (auto &arcs : pip_arcs) {
+        for (auto &arc : arcs) {
+            // Consecutive pips are usually in the same tile, so save looking it up every time
+            if (last_tile == nullptr || arc.tile != last_tile_name) {
+                last_tile = &cc.tiles[arc.tile];
+                last_tile_name = arc.tile;
             }
+            last_tile->carcs.push_back(ConfigArc{std::move(arc.sink), std::move(arc.source)});
         }
     }
     // Find bank voltages
@@ -1530,7 +1555,7 @@ void write_bitstream(Context *ctx, std::string base_config_file, std::string tex
     // Configure chip
     if (!text_config_file.empty()) {
         std::ofstream out_config(text_config_file);
-        out_config << cc;
+        write_chip_config(out_config, cc, ThreadPool::default_threads(ctx));
     }
 }
 
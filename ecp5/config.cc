@@ -21,6 +21,7 @@
 #include <boost/range/adaptor/reversed.hpp>
 #include <iomanip>
 #include "log.h"
+#include "thread_pool.h"
 NEXTPNR_NAMESPACE_BEGIN
 
 #define fmt(x) (static_cast<const std::ostringstream &>(std::ostringstream() << x).str())
@@ -139,7 +140,7 @@ inline bool skip_check_eof(std::istream &in)
 
 std::ostream &operator<<(std::ostream &out, const ConfigArc &arc)
 {
-    out << "arc: " << arc.sink << " " << arc.source << std::endl;
+    out << "arc: " << arc.sink << " " << arc.source << '\n';
     return out;
 }
 
@@ -152,7 +153,7 @@ std::istream &operator>>(std::istream &in, ConfigArc &arc)
 
 std::ostream &operator<<(std::ostream &out, const ConfigWord &cw)
 {
-    out << "word: " << cw.name << " " << to_string(cw.value) << std::endl;
+    out << "word: " << cw.name << " " << to_string(cw.value) << '\n';
     return out;
 }
 
@@ -165,7 +166,7 @@ std::istream &operator>>(std::istream &in, ConfigWord &cw)
 
 std::ostream &operator<<(std::ostream &out, const ConfigEnum &cw)
 {
-    out << "enum: " << cw.name << " " << cw.value << std::endl;
+    out << "enum: " << cw.name << " " << cw.value << '\n';
     return out;
 }
 
@@ -178,7 +179,7 @@ std::istream &operator>>(std::istream &in, ConfigEnum &ce)
 
 std::ostream &operator<<(std::ostream &out, const ConfigUnknown &cu)
 {
-    out << "unknown: " << to_string(ConfigBit{cu.frame, cu.bit, false}) << std::endl;
+    out << "unknown: " << to_string(ConfigBit{cu.frame, cu.bit, false}) << '\n';
     return out;
 }
 
@@ -264,42 +265,65 @@ bool TileConfig::empty() const { return carcs.empty() && cwords.empty() && cenum
 
 std::ostream &operator<<(std::ostream &out, const ChipConfig &cc)
 {
-    out << ".device " << cc.chip_name << std::endl << std::endl;
+    write_chip_config(out, cc, 1);
+    return out;
+}
+
+void write_chip_config(std::ostream &out, const ChipConfig &cc, int threads)
+{
+    // Lines end with '\n' rather than std::endl, as flushing after every line is the most expensive part of writing a
+    // large config
+    out << ".device " << cc.chip_name << '\n' << '\n';
     for (const auto &meta : cc.metadata)
-        out << ".comment " << meta << std::endl;
+        out << ".comment " << meta << '\n';
     for (const auto &sc : cc.sysconfig)
-        out << ".sysconfig " << sc.first << " " << sc.second << std::endl;
-    out << std::endl;
+        out << ".sysconfig " << sc.first << " " << sc.second << '\n';
+    out << '\n';
+
+    // Format the tiles in parallel, then write them in order
+    std::vector<const std::pair<const std::string, TileConfig> *> tiles;
     for (const auto &tile : cc.tiles) {
-        if (!tile.second.empty()) {
-            out << ".tile " << tile.first << std::endl;
-            out << tile.second;
-            out << std::endl;
-        }
+        if (!tile.second.empty())
+            tiles.push_back(&tile);
     }
+    std::vector<std::string> tile_text(tiles.size());
+    ThreadPool pool(threads);
+    pool.parallel_for(
+            0, tiles.size(),
+            [&](size_t i) {
+                std::ostringstream ss;
+                ss << ".tile " << tiles.at(i)->first << '\n';
+                ss << tiles.at(i)->second;
+                ss << '\n';
+                tile_text.at(i) = ss.str();
+            },
+            16);
+    for (const auto &text : tile_text)
+        out << text;
+
     for (const auto &bram : cc.bram_data) {
-        out << ".bram_init " << bram.first << std::endl;
+        out << ".bram_init " << bram.first << '\n';
         std::ios_base::fmtflags f(out.flags());
         for (size_t i = 0; i < bram.second.size(); i++) {
             out << std::setw(3) << std::setfill('0') << std::hex << bram.second.at(i);
             if (i % 8 == 7)
-                out << std::endl;
+                out << '\n';
             else
                 out << " ";
         }
         out.flags(f);
-        out << std::endl;
+        out << '\n';
     }
     for (const auto &tg : cc.tilegroups) {
         out << ".tile_group";
         for (const auto &tile : tg.tiles) {
             out << " " << tile;
         }
-        out << std::endl;
+        out << '\n';
         out << tg.config;
-        out << std::endl;
+        out << '\n';
     }
-    return out;
+    out.flush();
 }
 
 std::istream &operator>>(std::istream &in, ChipConfig &cc)
@@ -120,6 +120,10 @@ class ChipConfig
 
 std::ostream &operator<<(std::ostream &out, const ChipConfig &cc);
 
+// Write a ChipConfig in Trellis text format, as operator<< does, but formatting the text for the tiles on several
+// threads
+void write_chip_config(std::ostream &out, const ChipConfig &cc, int threads);
+
 std::istream &operator>>(std::istream &in, ChipConfig &cc);
 
 NEXTPNR_NAMESPACE_END
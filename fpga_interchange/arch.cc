@@ -27,6 +27,7 @@
 #include <boost/uuid/detail/sha1.hpp>
 #include <cmath>
 #include <cstring>
+#include <limits>
 #include <queue>
 
 #include "constraints.impl.h"
@@ -292,6 +293,15 @@ Arch::Arch(ArchArgs args) : args(args), disallow_site_routing(false)
             std::regex("([0-9]+)'h([0-9a-fA-F]+)", std::regex_constants::ECMAScript | std::regex_constants::optimize);
 
     default_tags.resize(max_tag_count);
+
+    int64_t wire_index_end = chip_info->nodes.ssize();
+    tile_wire_index_base.reserve(chip_info->tiles.size());
+    for (const TileInstInfoPOD &tile : chip_info->tiles) {
+        tile_wire_index_base.push_back(int(wire_index_end));
+        wire_index_end += chip_info->tile_types[tile.type].wire_data.ssize();
+    }
+    NPNR_ASSERT(wire_index_end <= std::numeric_limits<int>::max());
+    wire_index_count = int(wire_index_end);
 }
 
 void Arch::init()
@@ -302,6 +312,10 @@ void Arch::init()
     dedicated_interconnect.init(getCtx());
     cell_parameters.init(getCtx());
 
+    if (!args.rebuild_site_routing_cache) {
+        site_routing_cache.read_cache(get_chipdb_hash(), site_routing_cache_filename());
+    }
+
     for (size_t tile_type = 0; tile_type < chip_info->tile_types.size(); ++tile_type) {
         pseudo_pip_data.init_tile_type(getCtx(), tile_type);
     }
@@ -781,6 +795,7 @@ bool Arch::place()
     archInfoToAttributes();
 
     getCtx()->check();
+    write_site_routing_cache();
 
     return true;
 }
@@ -802,15 +817,26 @@ static void prepare_sites_for_routing(Context *ctx)
     // Have site router bind site routing (via bindPip and bindWire).
     // This is important so that the pseudo pips are correctly blocked prior
     // to handing the design to the generalized router algorithms.
+    //
+    // Any sites not yet checked are checked first, as binding requires it.
+    // Both steps work on all sites at once, so they can use several threads.
+    std::vector<std::pair<const SiteRouter *, const TileStatus *>> sites_to_check;
+    std::vector<SiteRouter *> sites_to_bind;
     for (auto &tile_pair : ctx->tileStatus) {
         for (auto &site_router : tile_pair.second.sites) {
             if (site_router.cells_in_site.empty()) {
                 continue;
             }
 
-            site_router.bindSiteRouting(ctx);
+            sites_to_check.emplace_back(&site_router, &tile_pair.second);
+            sites_to_bind.push_back(&site_router);
         }
+    }
+
+    check_site_routing(ctx, sites_to_check);
+    bind_site_routing(ctx, sites_to_bind);
 
+    for (auto &tile_pair : ctx->tileStatus) {
         tile_pair.second.pseudo_pip_model.prepare_for_routing(ctx, tile_pair.second.sites);
     }
 
@@ -899,6 +925,7 @@ bool Arch::route()
     unmask_bel_pins();
 
     getCtx()->check();
+    write_site_routing_cache();
 
     return result;
 }
@@ -1817,6 +1844,15 @@ bool Arch::checkPipAvail(PipId pip) const { return checkPipAvailForNet(pip, null
 
 std::string Arch::get_chipdb_hash() const { return chipdb_hash; }
 
+std::string Arch::site_routing_cache_filename() const { return args.chipdb + ".site_routing"; }
+
+void Arch::write_site_routing_cache()
+{
+    if (!args.dont_write_site_routing_cache) {
+        site_routing_cache.write_cache(get_chipdb_hash(), site_routing_cache_filename());
+    }
+}
+
 bool Arch::is_inverting(PipId pip) const
 {
     auto &tile_type = loc_info(chip_info, pip);
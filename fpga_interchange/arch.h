@@ -50,6 +50,8 @@ struct ArchArgs
     std::string package;
     bool rebuild_lookahead;
     bool dont_write_lookahead;
+    bool rebuild_site_routing_cache = false;
+    bool dont_write_site_routing_cache = false;
 };
 
 struct ArchRanges
@@ -449,6 +451,11 @@ struct Arch : ArchAPI<ArchRanges>
     std::vector<std::pair<IdString, std::string>> getWireAttrs(WireId wire) const final;
 
     uint32_t getWireChecksum(WireId wire) const final { return wire.index; }
+    int getWireIndexCount() const final { return wire_index_count; }
+    int getWireIndex(WireId wire) const final
+    {
+        return wire.tile == -1 ? wire.index : tile_wire_index_base[wire.tile] + wire.index;
+    }
 
     void bindWire(WireId wire, NetInfo *net, PlaceStrength strength) final;
 
@@ -1080,12 +1087,20 @@ struct Arch : ArchAPI<ArchRanges>
     Lookahead lookahead;
     mutable RouteNodeStorage node_storage;
     mutable SiteRoutingCache site_routing_cache;
+    std::string site_routing_cache_filename() const;
+    void write_site_routing_cache();
     bool disallow_site_routing;
     CellParameters cell_parameters;
 
     std::string chipdb_hash;
     std::string get_chipdb_hash() const;
 
+    // Dense wire indices: nodes come first, then the wires of each tile
+    // from tile_wire_index_base[tile].  Tile wires that are part of a node
+    // leave gaps.
+    int wire_index_count;
+    std::vector<int> tile_wire_index_base;
+
     // Masking moves BEL pins from cell_bel_pins to masked_cell_bel_pins for
     // the purposes routing.  The idea is that masked BEL pins are already
     // handled during site routing, and they shouldn't be visible to the
@@ -0,0 +1,198 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  Symbiflow Authors
+ *
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "capnp_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <zlib.h>
+
+#include "thread_pool.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+namespace {
+
+// Messages are compressed in blocks of this size, each on its own thread
+const size_t compress_block_size = 1 << 20;
+// Largest number of segments capnp will write or read
+const uint32_t max_segments = 512;
+// Deflate can't compress data by more than this ratio, which bounds the size of the message in a gzip file
+const uint64_t max_deflate_ratio = 1032;
+
+bool gzread_all(gzFile file, void *data, size_t size)
+{
+    char *dst = reinterpret_cast<char *>(data);
+    while (size > 0) {
+        int ret = gzread(file, dst, unsigned(std::min<size_t>(size, 1U << 30)));
+        if (ret <= 0)
+            return false;
+        dst += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+// Read a whole message from a gzip file of file_size bytes. The segment table at the start gives the size of the
+// message: a count of segments, less one; the size of each segment, in words; then padding to a whole word
+kj::Array<capnp::word> read_gzip_message(const std::string &filename, uint64_t file_size)
+{
+    gzFile file = gzopen(filename.c_str(), "rb");
+    if (file == Z_NULL)
+        return nullptr;
+    gzbuffer(file, 1 << 20);
+
+    kj::Array<capnp::word> words;
+    // Room for the count, max_segments sizes and the padding
+    uint32_t table[max_segments + 2];
+    if (gzread_all(file, table, sizeof(uint32_t)) && table[0] < max_segments) {
+        uint32_t segments = table[0] + 1;
+        size_t table_entries = (segments + 2) & ~1U;
+        if (gzread_all(file, table + 1, (table_entries - 1) * sizeof(uint32_t))) {
+            size_t table_words = table_entries / 2;
+            uint64_t total_words = table_words;
+            for (uint32_t i = 0; i < segments; i++)
+                total_words += table[i + 1];
+            // A damaged file can claim a message far larger than it could hold; don't try to allocate that
+            if (total_words * sizeof(capnp::word) <= file_size * max_deflate_ratio) {
+                words = kj::heapArray<capnp::word>(total_words);
+                std::memcpy(words.begin(), table, table_words * sizeof(capnp::word));
+                if (!gzread_all(file, words.begin() + table_words, (total_words - table_words) * sizeof(capnp::word)))
+                    words = nullptr;
+            }
+        }
+    }
+    gzclose(file);
+    return words;
+}
+
+bool gzip_block(const char *data, size_t size, std::string &result)
+{
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    // 15 bits of window, plus 16 to write a gzip header and trailer
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    result.resize(deflateBound(&zs, size));
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    zs.avail_in = uInt(size);
+    zs.next_out = reinterpret_cast<Bytef *>(&result[0]);
+    zs.avail_out = uInt(result.size());
+    int ret = deflate(&zs, Z_FINISH);
+    result.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+} // namespace
+
+CapnpFileReader::CapnpFileReader(const std::string &filename)
+{
+    capnp::ReaderOptions reader_options;
+    reader_options.traversalLimitInWords = 32llu * 1024llu * 1024llu * 1024llu;
+
+    unsigned char magic[2] = {0, 0};
+    uint64_t file_size = 0;
+    {
+        std::ifstream in(filename, std::ios::binary | std::ios::ate);
+        if (!in)
+            return;
+        file_size = uint64_t(in.tellg());
+        in.seekg(0);
+        in.read(reinterpret_cast<char *>(magic), sizeof(magic));
+    }
+
+    kj::ArrayPtr<const capnp::word> message;
+    if (magic[0] == 0x1f && magic[1] == 0x8b) {
+        words = read_gzip_message(filename, file_size);
+        if (words == nullptr)
+            return;
+        message = words.asPtr();
+    } else {
+        try {
+            mapped.open(filename);
+        } catch (std::ios_base::failure &) {
+            return;
+        }
+        if (!mapped.is_open())
+            return;
+        message = kj::arrayPtr(reinterpret_cast<const capnp::word *>(mapped.data()),
+                               mapped.size() / sizeof(capnp::word));
+    }
+    reader.reset(new capnp::FlatArrayMessageReader(message, reader_options));
+}
+
+bool write_capnp_file(capnp::MessageBuilder &message, const std::string &filename, bool compress, int threads)
+{
+    auto segments = message.getSegmentsForOutput();
+
+    // The segment table, laid out as by capnp::writeMessage
+    std::vector<uint32_t> table((segments.size() + 2) & ~size_t(1), 0);
+    table[0] = uint32_t(segments.size() - 1);
+    for (size_t i = 0; i < segments.size(); i++)
+        table[i + 1] = uint32_t(segments[i].size());
+
+    std::vector<std::pair<const char *, size_t>> pieces;
+    pieces.emplace_back(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(uint32_t));
+    for (auto segment : segments)
+        pieces.emplace_back(reinterpret_cast<const char *>(segment.begin()), segment.size() * sizeof(capnp::word));
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out)
+        return false;
+
+    if (!compress) {
+        for (auto &piece : pieces)
+            out.write(piece.first, piece.second);
+        return bool(out);
+    }
+
+    std::vector<std::pair<const char *, size_t>> blocks;
+    for (auto &piece : pieces)
+        for (size_t offset = 0; offset < piece.second; offset += compress_block_size)
+            blocks.emplace_back(piece.first + offset, std::min(compress_block_size, piece.second - offset));
+
+    // Compress a few blocks per thread at a time, writing each batch out in order, so the compressed file is never
+    // held in memory all at once
+    ThreadPool pool(threads);
+    size_t batch_size = size_t(pool.size()) * 4;
+    std::vector<std::string> compressed(batch_size);
+    for (size_t start = 0; start < blocks.size(); start += batch_size) {
+        size_t end = std::min(blocks.size(), start + batch_size);
+        std::atomic<bool> failed(false);
+        pool.parallel_for(
+                start, end,
+                [&](size_t i) {
+                    if (!gzip_block(blocks.at(i).first, blocks.at(i).second, compressed.at(i - start)))
+                        failed = true;
+                },
+                1);
+        if (failed)
+            return false;
+        for (size_t i = start; i < end; i++)
+            out.write(compressed.at(i - start).data(), compressed.at(i - start).size());
+    }
+    return bool(out);
+}
+
+NEXTPNR_NAMESPACE_END
@@ -0,0 +1,61 @@
+/*
+ *  nextpnr -- Next Generation Place and Route
+ *
+ *  Copyright (C) 2021  Symbiflow Authors
+ *
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef CAPNP_FILE_H
+#define CAPNP_FILE_H
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <capnp/message.h>
+#include <capnp/serialize.h>
+#include <memory>
+#include <string>
+
+#include "nextpnr_namespaces.h"
+
+NEXTPNR_NAMESPACE_BEGIN
+
+// A capnp message read from a file, which may be gzip compressed.
+//
+// An uncompressed file is mapped and read in place. A compressed file is decompressed straight into one buffer, sized
+// from the segment table at the start of the message, so the message is never copied or held twice.
+class CapnpFileReader
+{
+  public:
+    explicit CapnpFileReader(const std::string &filename);
+
+    // False if the file couldn't be read
+    bool is_open() const { return reader != nullptr; }
+
+    template <typename T> typename T::Reader getRoot() { return reader->getRoot<T>(); }
+
+  private:
+    boost::iostreams::mapped_file_source mapped;
+    kj::Array<capnp::word> words;
+    std::unique_ptr<capnp::FlatArrayMessageReader> reader;
+};
+
+// Write a capnp message to a file, straight from its segments rather than from a flattened copy. If compress is set,
+// the file is gzip compressed: blocks of the message are compressed on several threads and written as consecutive
+// gzip members, which gzip readers decompress as a single stream. Returns false if the file couldn't be written.
+bool write_capnp_file(capnp::MessageBuilder &message, const std::string &filename, bool compress, int threads);
+
+NEXTPNR_NAMESPACE_END
+
+#endif /* CAPNP_FILE_H */
@@ -30,7 +30,7 @@ add_subdirectory(${family}/examples/devices)
 add_subdirectory(${family}/examples/boards)
 add_subdirectory(${family}/examples/tests)
 
-set(PROTOS lookahead.capnp)
+set(PROTOS lookahead.capnp site_routing_cache.capnp)
 set(CAPNP_SRCS)
 set(CAPNP_HDRS)
 find_package(CapnProto REQUIRED)
@@ -20,27 +20,16 @@
 
 #include "fpga_interchange.h"
 #include <capnp/message.h>
-#include <sstream>
 #include <capnp/serialize.h>
-#include <kj/std/iostream.h>
 #include "PhysicalNetlist.capnp.h"
 #include "LogicalNetlist.capnp.h"
-#include "zlib.h"
+#include "capnp_file.h"
 #include "frontend_base.h"
+#include "thread_pool.h"
+#include "util.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
-static void write_message(::capnp::MallocMessageBuilder & message, const std::string &filename) {
-    kj::Array<capnp::word> words = messageToFlatArray(message);
-    kj::ArrayPtr<kj::byte> bytes = words.asBytes();
-
-    gzFile file = gzopen(filename.c_str(), "w");
-    NPNR_ASSERT(file != Z_NULL);
-
-    NPNR_ASSERT(gzwrite(file, &bytes[0], bytes.size()) == (int)bytes.size());
-    NPNR_ASSERT(gzclose(file) == Z_OK);
-}
-
 struct StringEnumerator {
     std::vector<std::string> strings;
     std::unordered_map<std::string, size_t> string_to_index;
@@ -678,7 +667,10 @@ void FpgaInterchange::write_physical_netlist(const Context * ctx, const std::str
         str_list.set(i, strings.strings[i]);
     }
 
-    write_message(message, filename);
+    bool compress = !bool_or_default(ctx->settings, ctx->id("fpga_interchange/uncompressedPhys"), false);
+    if(!write_capnp_file(message, filename, compress, ThreadPool::default_threads(ctx))) {
+        log_error("Failed to write physical netlist '%s'.\n", filename.c_str());
+    }
 }
 
 struct LogicalNetlistImpl;
@@ -1072,35 +1064,11 @@ ModuleReader::ModuleReader(const LogicalNetlistImpl *root,
 }
 
 void FpgaInterchange::read_logical_netlist(Context * ctx, const std::string &filename) {
-    gzFile file = gzopen(filename.c_str(), "r");
-    NPNR_ASSERT(file != Z_NULL);
-
-    std::vector<uint8_t> output_data;
-    output_data.resize(4096);
-    std::stringstream sstream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
-    while(true) {
-        int ret = gzread(file, output_data.data(), output_data.size());
-        NPNR_ASSERT(ret >= 0);
-        if(ret > 0) {
-            sstream.write((const char*)output_data.data(), ret);
-            NPNR_ASSERT(sstream);
-        } else {
-            NPNR_ASSERT(ret == 0);
-            int error;
-            gzerror(file, &error);
-            NPNR_ASSERT(error == Z_OK);
-            break;
-        }
+    CapnpFileReader message_reader(filename);
+    if(!message_reader.is_open()) {
+        log_error("Failed to read logical netlist '%s'.\n", filename.c_str());
     }
 
-    NPNR_ASSERT(gzclose(file) == Z_OK);
-
-    sstream.seekg(0);
-    kj::std::StdInputStream istream(sstream);
-    capnp::ReaderOptions reader_options;
-    reader_options.traversalLimitInWords = 32llu*1024llu*1024llu*1024llu;
-    capnp::InputStreamMessageReader message_reader(istream, reader_options);
-
     LogicalNetlist::Netlist::Reader netlist = message_reader.getRoot<LogicalNetlist::Netlist>();
     LogicalNetlistImpl netlist_reader(netlist);
 
@@ -50,13 +50,15 @@ FpgaInterchangeCommandHandler::FpgaInterchangeCommandHandler(int argc, char **ar
 po::options_description FpgaInterchangeCommandHandler::getArchOptions()
 {
     po::options_description specific("Architecture specific options");
-    specific.add_options()("chipdb", po::value<std::string>(), "name of chip database binary");
     specific.add_options()("xdc", po::value<std::vector<std::string>>(), "XDC-style constraints file to read");
     specific.add_options()("netlist", po::value<std::string>(), "FPGA interchange logical netlist to read");
     specific.add_options()("phys", po::value<std::string>(), "FPGA interchange Physical netlist to write");
+    specific.add_options()("phys-uncompressed", "Write the physical netlist without gzip compression");
     specific.add_options()("package", po::value<std::string>(), "Package to use");
     specific.add_options()("rebuild-lookahead", "Ignore lookahead cache and rebuild");
     specific.add_options()("dont-write-lookahead", "Don't write the lookahead file");
+    specific.add_options()("rebuild-site-routing-cache", "Ignore site routing cache and rebuild");
+    specific.add_options()("dont-write-site-routing-cache", "Don't write the site routing cache file");
 
     return specific;
 }
@@ -76,6 +78,8 @@ std::unique_ptr<Context> FpgaInterchangeCommandHandler::createContext(std::unord
     ArchArgs chipArgs;
     chipArgs.rebuild_lookahead = vm.count("rebuild_lookahead") != 0;
     chipArgs.dont_write_lookahead = vm.count("dont_write_lookahead") != 0;
+    chipArgs.rebuild_site_routing_cache = vm.count("rebuild-site-routing-cache") != 0;
+    chipArgs.dont_write_site_routing_cache = vm.count("dont-write-site-routing-cache") != 0;
 
     if (!vm.count("chipdb")) {
         log_error("chip database binary must be provided\n");
@@ -95,6 +99,10 @@ std::unique_ptr<Context> FpgaInterchangeCommandHandler::createContext(std::unord
         ctx->debug = true;
     }
 
+    if (vm.count("phys-uncompressed")) {
+        ctx->settings[ctx->id("fpga_interchange/uncompressedPhys")] = true;
+    }
+
     ctx->init();
 
     if (vm.count("netlist")) {
@@ -19,11 +19,15 @@
 
 #include "nextpnr.h"
 
+#include <atomic>
+#include <memory>
+
 #include "design_utils.h"
 #include "dynamic_bitarray.h"
 #include "hash_table.h"
 #include "log.h"
 #include "site_routing_cache.h"
+#include "thread_pool.h"
 
 #include "site_arch.h"
 #include "site_arch.impl.h"
@@ -315,6 +319,15 @@ struct SiteExpansionLoop
     bool solution_can_invert(size_t idx) const { return solution.solution_can_invert(idx); }
 };
 
+// Site routing state that is otherwise kept in the Context and on each net.
+// When sites are routed in parallel, each thread has its own, as two sites
+// sharing a net would otherwise share its expansion loop.
+struct SiteRoutingScratch
+{
+    RouteNodeStorage node_storage;
+    HashTables::HashMap<NetInfo *, std::unique_ptr<SiteExpansionLoop>> loops;
+};
+
 void print_current_state(const SiteArch *site_arch)
 {
     const Context *ctx = site_arch->ctx;
@@ -676,7 +689,7 @@ static bool find_solution_via_backtrack(SiteArch *ctx, std::vector<PossibleSolut
 }
 
 static bool route_site(SiteArch *ctx, SiteRoutingCache *site_routing_cache, RouteNodeStorage *node_storage,
-                       bool explain)
+                       SiteRoutingScratch *scratch, bool explain)
 {
     // Overview:
     // - Starting from each site net source, expand the site routing graph
@@ -692,12 +705,21 @@ static bool route_site(SiteArch *ctx, SiteRoutingCache *site_routing_cache, Rout
     for (auto &net_pair : ctx->nets) {
         SiteNetInfo *net = &net_pair.second;
 
-        if (net->net->loop == nullptr) {
-            net->net->loop = new SiteExpansionLoop(node_storage);
+        SiteExpansionLoop *router;
+        if (scratch != nullptr) {
+            auto &loop = scratch->loops[net->net];
+            if (loop == nullptr) {
+                loop.reset(new SiteExpansionLoop(&scratch->node_storage));
+            }
+            router = loop.get();
+        } else {
+            if (net->net->loop == nullptr) {
+                net->net->loop = new SiteExpansionLoop(node_storage);
+            }
+            router = net->net->loop;
         }
-        expansions.push_back(net->net->loop);
+        expansions.push_back(router);
 
-        SiteExpansionLoop *router = expansions.back();
         if (!router->expand_net(ctx, site_routing_cache, net)) {
             if (verbose_site_router(ctx) || explain) {
                 log_info("Net %s expansion failed to reach all users, site is unroutable!\n", ctx->nameOfNet(net));
@@ -1058,7 +1080,7 @@ static void block_lut_outputs(SiteArch *site_arch,
     }
 }
 
-bool SiteRouter::checkSiteRouting(const Context *ctx, const TileStatus &tile_status) const
+bool SiteRouter::checkSiteRouting(const Context *ctx, const TileStatus &tile_status, SiteRoutingScratch *scratch) const
 {
     // Overview:
     //  - Make sure all cells in site satisfy the constraints.
@@ -1139,7 +1161,7 @@ bool SiteRouter::checkSiteRouting(const Context *ctx, const TileStatus &tile_sta
 
     // Do a detailed routing check to see if the site has at least 1 valid
     // routing solution.
-    site_ok = route_site(&site_arch, &ctx->site_routing_cache, &ctx->node_storage, /*explain=*/false);
+    site_ok = route_site(&site_arch, &ctx->site_routing_cache, &ctx->node_storage, scratch, /*explain=*/false);
     if (verbose_site_router(ctx)) {
         if (site_ok) {
             log_info("Site %s is routable\n", ctx->get_site_name(tile, site));
@@ -1154,25 +1176,92 @@ bool SiteRouter::checkSiteRouting(const Context *ctx, const TileStatus &tile_sta
     return site_ok;
 }
 
-void SiteRouter::bindSiteRouting(Context *ctx)
+void SiteRouter::bindSiteRouting(Context *ctx) { bind_site_routing(ctx, {this}); }
+
+// Runs site routing work for a batch of sites on the threads given by the
+// "threads" setting, each thread with its own scratch state.
+class SiteRoutingWorkers
 {
-    NPNR_ASSERT(!dirty);
-    NPNR_ASSERT(site_ok);
+  public:
+    explicit SiteRoutingWorkers(const Context *ctx)
+            // Verbose site router output isn't thread safe.
+            : ctx(ctx), threads(verbose_site_router(ctx) ? 1 : ThreadPool::default_threads(ctx))
+    {
+    }
 
-    // Make sure all cells in this site belong!
-    auto iter = cells_in_site.begin();
-    NPNR_ASSERT((*iter)->bel != BelId());
+    // Call func(i, scratch) for each i in [0, count).  When working on one
+    // thread, scratch is null and the state kept in the Context is used, just
+    // as when routing a single site.
+    template <typename Func> void for_each(size_t count, Func func)
+    {
+        if (threads <= 1 || count <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                func(i, nullptr);
+            }
+            return;
+        }
 
-    auto tile = (*iter)->bel.tile;
-    auto &tile_type = loc_info(ctx->chip_info, (*iter)->bel);
+        if (pool == nullptr) {
+            // Site routing looks this IdString up, which is only safe from
+            // several threads once it exists.
+            ctx->id("$nextpnr_blocked_net");
+
+            pool.reset(new ThreadPool(threads));
+            scratch = std::vector<SiteRoutingScratch>(pool->size());
+        }
+
+        std::atomic<size_t> next(0);
+        pool->run_on_all([&](int thread_idx) {
+            while (true) {
+                size_t i = next.fetch_add(1);
+                if (i >= count) {
+                    break;
+                }
+                func(i, &scratch.at(thread_idx));
+            }
+        });
+    }
+
+  private:
+    const Context *ctx;
+    int threads;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<SiteRoutingScratch> scratch;
+};
+
+void check_site_routing(const Context *ctx, const std::vector<std::pair<const SiteRouter *, const TileStatus *>> &sites)
+{
+    std::vector<std::pair<const SiteRouter *, const TileStatus *>> dirty_sites;
+    for (const auto &site : sites) {
+        if (site.first->dirty) {
+            dirty_sites.push_back(site);
+        }
+    }
+
+    SiteRoutingWorkers workers(ctx);
+    workers.for_each(dirty_sites.size(), [&](size_t i, SiteRoutingScratch *scratch) {
+        dirty_sites[i].first->checkSiteRouting(ctx, *dirty_sites[i].second, scratch);
+    });
+}
+
+// A site routed by bind_site_routing, waiting to be applied to the design.
+struct RoutedSite
+{
+    std::unique_ptr<SiteInformation> site_info;
+    std::unique_ptr<SiteArch> site_arch;
+};
+
+// Unbind all bound site wires
+static void unbind_site_wires(Context *ctx, int32_t tile, int16_t site)
+{
+    auto &tile_type = ctx->chip_info->tile_types[ctx->chip_info->tiles[tile].type];
 
-    // Unbind all bound site wires
     WireId wire;
     wire.tile = tile;
     for (size_t wire_index = 0; wire_index < tile_type.wire_data.size(); ++wire_index) {
         const TileWireInfoPOD &wire_data = tile_type.wire_data[wire_index];
 
-        if (wire_data.site != this->site) {
+        if (wire_data.site != site) {
             continue;
         }
 
@@ -1188,19 +1277,56 @@ void SiteRouter::bindSiteRouting(Context *ctx)
             ctx->unbindWire(wire);
         }
     }
+}
 
-    SiteInformation site_info(ctx, tile, site, cells_in_site);
-    HashTables::HashSet<std::pair<IdString, IdString>, PairHash> blocked_wires;
-    NPNR_ASSERT(map_luts_in_site(site_info, &blocked_wires));
-
-    SiteArch site_arch(&site_info);
-    block_lut_outputs(&site_arch, blocked_wires);
-    NPNR_ASSERT(route_site(&site_arch, &ctx->site_routing_cache, &ctx->node_storage, /*explain=*/false));
-
-    check_routing(site_arch);
-    apply_routing(ctx, site_arch);
-    if (verbose_site_router(ctx)) {
-        print_current_state(&site_arch);
+void bind_site_routing(Context *ctx, const std::vector<SiteRouter *> &sites)
+{
+    // Routed sites are held until they are applied, so bound the number held
+    // at once.
+    const size_t max_batch_size = 4096;
+
+    SiteRoutingWorkers workers(ctx);
+    std::vector<RoutedSite> routed_sites;
+    for (size_t batch_start = 0; batch_start < sites.size(); batch_start += max_batch_size) {
+        size_t batch_size = std::min(max_batch_size, sites.size() - batch_start);
+        routed_sites.clear();
+        routed_sites.resize(batch_size);
+
+        // Routing a site only reads the design, apart from the LUT pin
+        // mapping of the cells within the site, so sites can be routed in
+        // parallel.
+        workers.for_each(batch_size, [&](size_t i, SiteRoutingScratch *scratch) {
+            const SiteRouter *site_router = sites[batch_start + i];
+            NPNR_ASSERT(!site_router->dirty);
+            NPNR_ASSERT(site_router->site_ok);
+
+            // Make sure all cells in this site belong!
+            auto iter = site_router->cells_in_site.begin();
+            NPNR_ASSERT((*iter)->bel != BelId());
+
+            auto tile = (*iter)->bel.tile;
+
+            RoutedSite &routed = routed_sites[i];
+            routed.site_info.reset(new SiteInformation(ctx, tile, site_router->site, site_router->cells_in_site));
+            HashTables::HashSet<std::pair<IdString, IdString>, PairHash> blocked_wires;
+            NPNR_ASSERT(map_luts_in_site(*routed.site_info, &blocked_wires));
+
+            routed.site_arch.reset(new SiteArch(routed.site_info.get()));
+            block_lut_outputs(routed.site_arch.get(), blocked_wires);
+            NPNR_ASSERT(route_site(routed.site_arch.get(), &ctx->site_routing_cache, &ctx->node_storage, scratch,
+                                   /*explain=*/false));
+
+            check_routing(*routed.site_arch);
+        });
+
+        for (size_t i = 0; i < batch_size; ++i) {
+            const RoutedSite &routed = routed_sites[i];
+            unbind_site_wires(ctx, routed.site_info->tile, sites[batch_start + i]->site);
+            apply_routing(ctx, *routed.site_arch);
+            if (verbose_site_router(ctx)) {
+                print_current_state(routed.site_arch.get());
+            }
+        }
     }
 }
 
@@ -1219,7 +1345,8 @@ void SiteRouter::explain(const Context *ctx) const
 
     SiteInformation site_info(ctx, tile, site, cells_in_site);
     SiteArch site_arch(&site_info);
-    bool route_status = route_site(&site_arch, &ctx->site_routing_cache, &ctx->node_storage, /*explain=*/true);
+    bool route_status =
+            route_site(&site_arch, &ctx->site_routing_cache, &ctx->node_storage, /*scratch=*/nullptr, /*explain=*/true);
     if (!route_status) {
         print_current_state(&site_arch);
     }
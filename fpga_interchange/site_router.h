@@ -22,6 +22,7 @@
 #define SITE_ROUTER_H
 
 #include <cstdint>
+#include <vector>
 
 #include "nextpnr_namespaces.h"
 #include "nextpnr_types.h"
@@ -32,6 +33,7 @@ NEXTPNR_NAMESPACE_BEGIN
 
 struct Context;
 struct TileStatus;
+struct SiteRoutingScratch;
 
 struct SiteRouter
 {
@@ -45,11 +47,24 @@ struct SiteRouter
 
     void bindBel(CellInfo *cell);
     void unbindBel(CellInfo *cell);
-    bool checkSiteRouting(const Context *ctx, const TileStatus &tile_status) const;
+    // scratch is only given when checking several sites in parallel, see
+    // check_site_routing.
+    bool checkSiteRouting(const Context *ctx, const TileStatus &tile_status,
+                          SiteRoutingScratch *scratch = nullptr) const;
     void bindSiteRouting(Context *ctx);
     void explain(const Context *ctx) const;
 };
 
+// Check the routing of a batch of sites, spreading the sites over the number
+// of threads given by the "threads" setting.  This has the same result as
+// calling checkSiteRouting on each site in turn.
+void check_site_routing(const Context *ctx, const std::vector<std::pair<const SiteRouter *, const TileStatus *>> &sites);
+
+// Bind the routing of a batch of sites.  The sites are routed in parallel,
+// then the routing of each is applied to the design in the order given, so
+// the result does not depend on the number of threads.
+void bind_site_routing(Context *ctx, const std::vector<SiteRouter *> &sites);
+
 NEXTPNR_NAMESPACE_END
 
 #endif /* SITE_ROUTER_H */
@@ -20,8 +20,13 @@
 
 #include "site_routing_cache.h"
 
+#include <boost/filesystem.hpp>
+
+#include "capnp_file.h"
 #include "context.h"
+#include "log.h"
 #include "site_arch.impl.h"
+#include "site_routing_cache.capnp.h"
 
 NEXTPNR_NAMESPACE_BEGIN
 
@@ -133,12 +138,15 @@ SiteRoutingKey SiteRoutingKey::make(const SiteArch *ctx, const SiteNetInfo &site
 bool SiteRoutingCache::get_solution(const SiteArch *ctx, const SiteNetInfo &net, SiteRoutingSolution *solution) const
 {
     SiteRoutingKey key = SiteRoutingKey::make(ctx, net);
-    auto iter = cache_.find(key);
-    if (iter == cache_.end()) {
-        return false;
-    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = cache_.find(key);
+        if (iter == cache_.end()) {
+            return false;
+        }
 
-    *solution = iter->second;
+        *solution = iter->second;
+    }
     const auto &tile_type_data = ctx->site_info->chip_info().tile_types[ctx->site_info->tile_type];
 
     for (SiteWire &wire : solution->solution_sinks) {
@@ -203,7 +211,227 @@ void SiteRoutingCache::add_solutions(const SiteArch *ctx, const SiteNetInfo &net
 {
     SiteRoutingKey key = SiteRoutingKey::make(ctx, net);
 
-    cache_[key] = solution;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = cache_.find(key);
+    if (iter == cache_.end()) {
+        cache_.emplace(std::move(key), solution);
+        new_solutions_ += 1;
+    } else {
+        iter->second = solution;
+    }
+}
+
+// Solutions are stored with only the indices of their wires and pips within
+// the tile type; get_solution fills in the tile and net when they are used.
+static void write_site_wire(const SiteWire &wire, site_routing_cache_storage::SiteWire::Builder builder)
+{
+    builder.setType(wire.type);
+    builder.setWireIndex(wire.wire.index);
+    builder.setPipIndex(wire.pip.index);
+}
+
+static bool read_site_wire(site_routing_cache_storage::SiteWire::Reader reader, SiteWire *wire)
+{
+    if (reader.getType() >= SiteWire::NUMBER_SITE_WIRE_TYPES) {
+        return false;
+    }
+
+    wire->type = SiteWire::Type(reader.getType());
+    wire->wire.index = reader.getWireIndex();
+    wire->pip.index = reader.getPipIndex();
+    return true;
+}
+
+static void write_entry(const SiteRoutingKey &key, const SiteRoutingSolution &solution,
+                        site_routing_cache_storage::SiteRoutingCacheEntry::Builder builder)
+{
+    auto key_builder = builder.initKey();
+    key_builder.setTileType(key.tile_type);
+    key_builder.setSite(key.site);
+    key_builder.setNetType(uint16_t(key.net_type));
+    key_builder.setDriverType(key.driver_type);
+    key_builder.setDriverIndex(key.driver_index);
+    auto user_types = key_builder.initUserTypes(key.user_types.size());
+    for (size_t i = 0; i < key.user_types.size(); ++i) {
+        user_types.set(i, key.user_types[i]);
+    }
+    auto user_indicies = key_builder.initUserIndicies(key.user_indicies.size());
+    for (size_t i = 0; i < key.user_indicies.size(); ++i) {
+        user_indicies.set(i, key.user_indicies[i]);
+    }
+
+    auto solution_builder = builder.initSolution();
+    auto offsets = solution_builder.initSolutionOffsets(solution.solution_offsets.size());
+    for (size_t i = 0; i < solution.solution_offsets.size(); ++i) {
+        offsets.set(i, solution.solution_offsets[i]);
+    }
+    auto storage = solution_builder.initSolutionStorage(solution.solution_storage.size());
+    for (size_t i = 0; i < solution.solution_storage.size(); ++i) {
+        const SitePip &pip = solution.solution_storage[i];
+        auto pip_builder = storage[i];
+        pip_builder.setType(pip.type);
+        pip_builder.setPipIndex(pip.pip.index);
+        // Only pips to and from out of site wires carry a wire; leave it unset for the others
+        if (pip.type == SitePip::SOURCE_TO_SITE_PORT || pip.type == SitePip::SITE_PORT_TO_SINK) {
+            write_site_wire(pip.wire, pip_builder.initWire());
+        }
+        pip_builder.setOtherPipIndex(pip.other_pip.index);
+    }
+    auto sinks = solution_builder.initSolutionSinks(solution.solution_sinks.size());
+    for (size_t i = 0; i < solution.solution_sinks.size(); ++i) {
+        write_site_wire(solution.solution_sinks[i], sinks[i]);
+    }
+    auto inverted = solution_builder.initInverted(solution.inverted.size());
+    for (size_t i = 0; i < solution.inverted.size(); ++i) {
+        inverted.set(i, solution.inverted[i] != 0);
+    }
+    auto can_invert = solution_builder.initCanInvert(solution.can_invert.size());
+    for (size_t i = 0; i < solution.can_invert.size(); ++i) {
+        can_invert.set(i, solution.can_invert[i] != 0);
+    }
+}
+
+static bool read_entry(site_routing_cache_storage::SiteRoutingCacheEntry::Reader reader, SiteRoutingKey *key,
+                       SiteRoutingSolution *solution)
+{
+    auto key_reader = reader.getKey();
+    key->tile_type = key_reader.getTileType();
+    key->site = key_reader.getSite();
+    key->net_type = PhysicalNetlist::PhysNetlist::NetType(key_reader.getNetType());
+    if (key_reader.getDriverType() >= SiteWire::NUMBER_SITE_WIRE_TYPES) {
+        return false;
+    }
+    key->driver_type = SiteWire::Type(key_reader.getDriverType());
+    key->driver_index = key_reader.getDriverIndex();
+    for (uint8_t user_type : key_reader.getUserTypes()) {
+        if (user_type >= SiteWire::NUMBER_SITE_WIRE_TYPES) {
+            return false;
+        }
+        key->user_types.push_back(SiteWire::Type(user_type));
+    }
+    for (int32_t user_index : key_reader.getUserIndicies()) {
+        key->user_indicies.push_back(user_index);
+    }
+
+    auto solution_reader = reader.getSolution();
+    for (uint32_t offset : solution_reader.getSolutionOffsets()) {
+        solution->solution_offsets.push_back(offset);
+    }
+    for (auto pip_reader : solution_reader.getSolutionStorage()) {
+        if (pip_reader.getType() >= SitePip::INVALID_TYPE) {
+            return false;
+        }
+        SitePip pip;
+        pip.type = SitePip::Type(pip_reader.getType());
+        pip.pip.index = pip_reader.getPipIndex();
+        if ((pip.type == SitePip::SOURCE_TO_SITE_PORT || pip.type == SitePip::SITE_PORT_TO_SINK) &&
+            !read_site_wire(pip_reader.getWire(), &pip.wire)) {
+            return false;
+        }
+        pip.other_pip.index = pip_reader.getOtherPipIndex();
+        solution->solution_storage.push_back(pip);
+    }
+    for (auto wire_reader : solution_reader.getSolutionSinks()) {
+        SiteWire wire;
+        if (!read_site_wire(wire_reader, &wire)) {
+            return false;
+        }
+        solution->solution_sinks.push_back(wire);
+    }
+    for (bool inverted : solution_reader.getInverted()) {
+        solution->inverted.push_back(inverted);
+    }
+    for (bool can_invert : solution_reader.getCanInvert()) {
+        solution->can_invert.push_back(can_invert);
+    }
+
+    // Check the solutions are consistent with each other, so the accessors
+    // won't run off the end of the storage.
+    size_t num_solutions = solution->solution_sinks.size();
+    if (solution->solution_offsets.size() != num_solutions + 1 || solution->inverted.size() != num_solutions ||
+        solution->can_invert.size() != num_solutions) {
+        return false;
+    }
+    for (size_t i = 0; i < num_solutions; ++i) {
+        if (solution->solution_offsets[i] > solution->solution_offsets[i + 1]) {
+            return false;
+        }
+    }
+    return solution->solution_offsets.front() == 0 &&
+           solution->solution_offsets.back() == solution->solution_storage.size();
+}
+
+bool SiteRoutingCache::read_cache(const std::string &chipdb_hash, const std::string &filename)
+{
+    CapnpFileReader file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    HashTables::HashMap<SiteRoutingKey, SiteRoutingSolution> solutions;
+    try {
+        auto cache = file.getRoot<site_routing_cache_storage::SiteRoutingCache>();
+        std::string expected_hash = cache.getChipdbHash();
+        if (chipdb_hash != expected_hash) {
+            return false;
+        }
+
+        for (auto entry : cache.getEntries()) {
+            SiteRoutingKey key;
+            SiteRoutingSolution solution;
+            if (!read_entry(entry, &key, &solution)) {
+                return false;
+            }
+            solutions.emplace(std::move(key), std::move(solution));
+        }
+    } catch (kj::Exception &) {
+        // A truncated or otherwise damaged cache is just ignored.
+        return false;
+    }
+
+    for (auto &entry : solutions) {
+        cache_.emplace(entry.first, std::move(entry.second));
+    }
+
+    return true;
+}
+
+void SiteRoutingCache::write_cache(const std::string &chipdb_hash, const std::string &filename)
+{
+    if (new_solutions_ == 0) {
+        return;
+    }
+
+    // Another run may have written the cache since it was read, so keep its
+    // solutions too.
+    read_cache(chipdb_hash, filename);
+
+    ::capnp::MallocMessageBuilder message;
+    auto cache = message.initRoot<site_routing_cache_storage::SiteRoutingCache>();
+    cache.setChipdbHash(chipdb_hash);
+    auto entries = cache.initEntries(cache_.size());
+    size_t i = 0;
+    for (const auto &entry : cache_) {
+        write_entry(entry.first, entry.second, entries[i++]);
+    }
+
+    // Write to a temporary file first, so a concurrent reader never sees a
+    // partial cache.
+    boost::system::error_code ec;
+    boost::filesystem::path temp = boost::filesystem::unique_path(filename + ".%%%%-%%%%-%%%%");
+    if (write_capnp_file(message, temp.string(), /*compress=*/false, /*threads=*/1)) {
+        boost::filesystem::rename(temp, filename, ec);
+    } else {
+        ec = boost::system::errc::make_error_code(boost::system::errc::io_error);
+    }
+
+    if (ec) {
+        boost::filesystem::remove(temp, ec);
+        log_warning("Failed to write site routing cache to %s\n", filename.c_str());
+        return;
+    }
+
+    new_solutions_ = 0;
 }
 
 NEXTPNR_NAMESPACE_END
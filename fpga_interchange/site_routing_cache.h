@@ -21,6 +21,8 @@
 #ifndef SITE_ROUTING_CACHE_H
 #define SITE_ROUTING_CACHE_H
 
+#include <mutex>
+
 #include "PhysicalNetlist.capnp.h"
 #include "hash_table.h"
 #include "nextpnr_namespaces.h"
@@ -127,14 +129,31 @@ template <> struct std::hash<NEXTPNR_NAMESPACE_PREFIX SiteRoutingKey>
 NEXTPNR_NAMESPACE_BEGIN
 
 // Provides an LRU cache for site routing solutions.
+//
+// Solutions only depend on the tile type and site, not on the tile or the
+// net, so the cache can be saved to disk and reused by later runs against
+// the same chipdb.
+//
+// The cache may be used by several threads routing sites at once.
 class SiteRoutingCache
 {
   public:
     bool get_solution(const SiteArch *ctx, const SiteNetInfo &net, SiteRoutingSolution *solution) const;
     void add_solutions(const SiteArch *ctx, const SiteNetInfo &net, const SiteRoutingSolution &solution);
 
+    // Add the solutions from a cache file to this cache, keeping any
+    // solutions already present.  Returns false if the file could not be read
+    // or was written for a different chipdb.
+    bool read_cache(const std::string &chipdb_hash, const std::string &filename);
+    // Merge the cache file with this cache, and write the result back.  Does
+    // nothing if no solutions have been added since the cache was last read
+    // or written.
+    void write_cache(const std::string &chipdb_hash, const std::string &filename);
+
   private:
+    mutable std::mutex mutex_;
     HashTables::HashMap<SiteRoutingKey, SiteRoutingSolution> cache_;
+    size_t new_solutions_ = 0;
 };
 
 NEXTPNR_NAMESPACE_END
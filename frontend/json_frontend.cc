@@ -181,24 +181,43 @@ struct JsonFrontendImpl
     }
 };
 
+namespace {
+Json load_json_modules(std::istream &in, const std::string &filename)
+{
+    if (!in)
+        log_error("Failed to open JSON file '%s'.\n", filename.c_str());
+    std::string json_str((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string error;
+    Json root = Json::parse(json_str, error, JsonParse::COMMENTS);
+    if (root.is_null())
+        log_error("Failed to parse JSON file '%s': %s.\n", filename.c_str(), error.c_str());
+    root = root["modules"];
+    if (root.is_null())
+        log_error("JSON file '%s' doesn't look like a netlist (doesn't contain \"modules\" key)\n", filename.c_str());
+    return root;
+}
+} // namespace
+
 bool parse_json(std::istream &in, const std::string &filename, Context *ctx)
 {
-    Json root;
-    {
-        if (!in)
-            log_error("Failed to open JSON file '%s'.\n", filename.c_str());
-        std::string json_str((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-        std::string error;
-        root = Json::parse(json_str, error, JsonParse::COMMENTS);
-        if (root.is_null())
-            log_error("Failed to parse JSON file '%s': %s.\n", filename.c_str(), error.c_str());
-        root = root["modules"];
-        if (root.is_null())
-            log_error("JSON file '%s' doesn't look like a netlist (doesn't contain \"modules\" key)\n",
-                      filename.c_str());
-    }
+    Json root = load_json_modules(in, filename);
     GenericFrontend<JsonFrontendImpl>(ctx, JsonFrontendImpl(root), /*split_io=*/true)();
     return true;
 }
 
+bool parse_json_routing(std::istream &in, const std::string &filename, Context *ctx,
+                        std::unordered_map<IdString, std::string> &routing)
+{
+    Json root = load_json_modules(in, filename);
+    for (const auto &mod : root.object_items()) {
+        for (const auto &netname : mod.second["netnames"].object_items()) {
+            const auto &attr = netname.second["attributes"]["ROUTING"];
+            if (!attr.is_string() || attr.string_value().empty())
+                continue;
+            routing[ctx->id(netname.first)] = Property::from_string(attr.string_value()).as_string();
+        }
+    }
+    return true;
+}
+
 NEXTPNR_NAMESPACE_END
@@ -22,5 +22,8 @@
 NEXTPNR_NAMESPACE_BEGIN
 
 bool parse_json(std::istream &in, const std::string &filename, Context *ctx);
+// Read the routing of each net, as stored in the ROUTING net attribute by --write, from a JSON file
+bool parse_json_routing(std::istream &in, const std::string &filename, Context *ctx,
+                        std::unordered_map<IdString, std::string> &routing);
 
 NEXTPNR_NAMESPACE_END
@@ -60,6 +60,7 @@ void Arch::addWire(IdStringList name, IdString type, int x, int y)
     wi.type = type;
     wi.x = x;
     wi.y = y;
+    wi.index = int(wire_ids.size());
 
     wire_ids.push_back(name);
 }
@@ -65,6 +65,7 @@ struct WireInfo
     std::vector<BelPin> bel_pins;
     DecalXY decalxy;
     int x, y;
+    int index;
 };
 
 struct PinInfo
@@ -261,6 +262,9 @@ struct Arch : ArchAPI<ArchRanges>
     IdString getWireType(WireId wire) const override;
     const std::map<IdString, std::string> &getWireAttrs(WireId wire) const override;
     uint32_t getWireChecksum(WireId wire) const override;
+    int getWireIndexCount() const override { return int(wire_ids.size()); }
+    // A hash map lookup, as WireId is a name here; this saves router2 from keeping a map of its own
+    int getWireIndex(WireId wire) const override { return wires.at(wire).index; }
     void bindWire(WireId wire, NetInfo *net, PlaceStrength strength) override;
     void unbindWire(WireId wire) override;
     bool checkWireAvail(WireId wire) const override;
@@ -361,6 +365,8 @@ struct Arch : ArchAPI<ArchRanges>
 
     bool isValidBelForCellType(IdString cell_type, BelId bel) const override { return cell_type == getBelType(bel); }
     bool isBelLocationValid(BelId bel) const override;
+    // Binding only touches the bel, and validity only depends on the cells in its tile
+    bool isBelBindLocal(BelId bel) const override { return true; }
 
     static const std::string defaultPlacer;
     static const std::vector<std::string> availablePlacers;
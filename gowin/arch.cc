@@ -956,8 +956,24 @@ const std::vector<GroupId> &Arch::getGroupGroups(GroupId group) const { return g
 
 // ---------------------------------------------------------------
 
+void Arch::init_delay_lookahead()
+{
+    if (!DelayLookahead::enabled(getCtx()))
+        return;
+    // Wire types are the wire names within a tile
+    for (auto wire : wire_ids)
+        wires.at(wire).lookahead_class = delay_lookahead.class_of(wires.at(wire).type.str(this));
+    delay_lookahead.init(getCtx(), stringf("gowin-%s", args.device.c_str()),
+                         [this](WireId wire) { return lookahead_wire(wire); });
+}
+
 delay_t Arch::estimateDelay(WireId src, WireId dst) const
 {
+    if (delay_lookahead.ready()) {
+        delay_t v = delay_lookahead.estimate(lookahead_wire(src), lookahead_wire(dst));
+        if (v >= 0)
+            return v;
+    }
     const WireInfo &s = wires.at(src);
     const WireInfo &d = wires.at(dst);
     int dx = abs(s.x - d.x);
@@ -1043,6 +1059,7 @@ bool Arch::place()
 bool Arch::route()
 {
     std::string router = str_or_default(settings, id("router"), defaultRouter);
+    init_delay_lookahead();
     bool result;
     if (router == "router1") {
         result = router1(getCtx(), Router1Cfg(getCtx()));
@@ -27,6 +27,7 @@
 #include <vector>
 
 #include "base_arch.h"
+#include "delay_lookahead.h"
 #include "idstring.h"
 #include "nextpnr_namespaces.h"
 #include "nextpnr_types.h"
@@ -195,6 +196,7 @@ struct WireInfo
     std::vector<BelPin> bel_pins;
     DecalXY decalxy;
     int x, y;
+    int lookahead_class = -1;
 };
 
 struct PinInfo
@@ -432,6 +434,19 @@ struct Arch : BaseArch<ArchRanges>
     delay_t getDelayFromNS(float ns) const override { return ns; }
 
     uint32_t getDelayChecksum(delay_t v) const override { return 0; }
+
+    // Sampled routing delays used by estimateDelay, if enabled
+    DelayLookahead delay_lookahead;
+    void init_delay_lookahead();
+    LookaheadWire lookahead_wire(WireId wire) const
+    {
+        const WireInfo &wi = wires.at(wire);
+        LookaheadWire lw;
+        lw.cls = wi.lookahead_class;
+        lw.x = wi.x;
+        lw.y = wi.y;
+        return lw;
+    }
     bool getBudgetOverride(const NetInfo *net_info, const PortRef &sink, delay_t &budget) const override;
 
     ArcBounds getRouteBoundingBox(WireId src, WireId dst) const override;
@@ -447,6 +462,8 @@ struct Arch : BaseArch<ArchRanges>
     TimingClockingInfo getPortClockingInfo(const CellInfo *cell, IdString port, int index) const override;
 
     bool isBelLocationValid(BelId bel) const override;
+    // Binding only touches the bel, and validity only depends on the cells in its tile
+    bool isBelBindLocal(BelId bel) const override { return true; }
 
     static const std::string defaultPlacer;
     static const std::vector<std::string> availablePlacers;
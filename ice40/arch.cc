@@ -127,6 +127,13 @@ Arch::Arch(ArchArgs args) : args(args)
     pip_to_net.resize(chip_info->pip_data.size());
     switches_locked.resize(chip_info->num_switches);
 
+    // Built up front, rather than on first use, so that bels can be looked up from multiple threads
+    for (size_t i = 0; i < chip_info->bel_data.size(); i++) {
+        BelId b;
+        b.index = i;
+        bel_by_loc[getBelLocation(b)] = i;
+    }
+
     BaseArch::init_cell_types();
     BaseArch::init_bel_buckets();
 }
@@ -220,14 +227,6 @@ BelId Arch::getBelByLocation(Loc loc) const
 {
     BelId bel;
 
-    if (bel_by_loc.empty()) {
-        for (size_t i = 0; i < chip_info->bel_data.size(); i++) {
-            BelId b;
-            b.index = i;
-            bel_by_loc[getBelLocation(b)] = i;
-        }
-    }
-
     auto it = bel_by_loc.find(loc);
     if (it != bel_by_loc.end())
         bel.index = it->second;
@@ -708,6 +707,7 @@ bool Arch::place()
 bool Arch::route()
 {
     std::string router = str_or_default(settings, id("router"), defaultRouter);
+    init_delay_lookahead();
     bool result;
     if (router == "router1") {
         result = router1(getCtx(), Router1Cfg(getCtx()));
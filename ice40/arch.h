@@ -23,6 +23,7 @@
 #include <cstdint>
 
 #include "base_arch.h"
+#include "delay_lookahead.h"
 #include "nextpnr_namespaces.h"
 #include "nextpnr_types.h"
 #include "relptr.h"
@@ -403,9 +404,9 @@ struct Arch : BaseArch<ArchRanges>
     mutable std::unordered_map<IdStringList, int> bel_by_name;
     mutable std::unordered_map<IdStringList, int> wire_by_name;
     mutable std::unordered_map<IdStringList, int> pip_by_name;
-    mutable std::unordered_map<Loc, int> bel_by_loc;
+    std::unordered_map<Loc, int> bel_by_loc;
 
-    std::vector<bool> bel_carry;
+    std::vector<uint8_t> bel_carry;
     std::vector<CellInfo *> bel_to_cell;
     std::vector<NetInfo *> wire_to_net;
     std::vector<NetInfo *> pip_to_net;
@@ -540,6 +541,9 @@ struct Arch : BaseArch<ArchRanges>
     IdString getWireType(WireId wire) const override;
     std::vector<std::pair<IdString, std::string>> getWireAttrs(WireId wire) const override;
 
+    int getWireIndexCount() const override { return chip_info->wire_data.ssize(); }
+    int getWireIndex(WireId wire) const override { return wire.index; }
+
     void bindWire(WireId wire, NetInfo *net, PlaceStrength strength) override
     {
         NPNR_ASSERT(wire != WireId());
@@ -794,6 +798,19 @@ struct Arch : BaseArch<ArchRanges>
 
     ArcBounds getRouteBoundingBox(WireId src, WireId dst) const override;
 
+    // Sampled routing delays used by estimateDelay, if enabled
+    DelayLookahead delay_lookahead;
+    std::vector<int> wire_lookahead_class;
+    void init_delay_lookahead();
+    LookaheadWire lookahead_wire(WireId wire) const
+    {
+        LookaheadWire lw;
+        lw.cls = wire_lookahead_class.at(wire.index);
+        lw.x = chip_info->wire_data[wire.index].x;
+        lw.y = chip_info->wire_data[wire.index].y;
+        return lw;
+    }
+
     // -------------------------------------------------
 
     bool pack() override;
@@ -831,6 +848,9 @@ struct Arch : BaseArch<ArchRanges>
 
     // Return true whether all Bels at a given location are valid
     bool isBelLocationValid(BelId bel) const override;
+    // Binding only touches the per-bel arrays. Logic cell validity only depends on the cells in the tile, but IO
+    // validity looks at any PLL driving the pad, which may be elsewhere
+    bool isBelBindLocal(BelId bel) const override { return getBelType(bel) != id_SB_IO; }
 
     // Helper function for above
     bool logic_cells_compatible(const CellInfo **it, const size_t size) const;
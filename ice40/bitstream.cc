@@ -22,6 +22,7 @@
 #include <cctype>
 #include <vector>
 #include "cells.h"
+#include "design_utils.h"
 #include "log.h"
 #include "util.h"
 
@@ -322,66 +323,66 @@ void write_asc(const Context *ctx, std::ostream &out)
     default:
         NPNR_ASSERT_FALSE("unsupported device type\n");
     }
-    // Set pips
-    for (auto pip : ctx->getPips()) {
-        if (ctx->pip_to_net[pip.index] != nullptr) {
-            const PipInfoPOD &pi = ci.pip_data[pip.index];
-            const SwitchInfoPOD &swi = bi.switches[pi.switch_index];
-            int sw_bel_idx = swi.bel;
-            if (sw_bel_idx >= 0) {
-                const BelInfoPOD &beli = ci.bel_data[sw_bel_idx];
-                const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_LOGIC];
-                BelId sw_bel;
-                sw_bel.index = sw_bel_idx;
-                NPNR_ASSERT(ctx->getBelType(sw_bel) == id_ICESTORM_LC);
-
-                if (ci.wire_data[ctx->getPipDstWire(pip).index].type == WireInfoPOD::WIRE_TYPE_LUTFF_IN_LUT)
-                    continue; // Permutation pips
-                BelPin output = get_one_bel_pin(ctx, ctx->getPipDstWire(pip));
-                NPNR_ASSERT(output.bel == sw_bel && output.pin == id_O);
-                unsigned lut_init;
-
-                WireId permWire;
-                for (auto permPip : ctx->getPipsUphill(ctx->getPipSrcWire(pip))) {
-                    if (ctx->getBoundPipNet(permPip) != nullptr) {
-                        permWire = ctx->getPipSrcWire(permPip);
-                    }
-                }
-                NPNR_ASSERT(permWire != WireId());
-                std::string dName = ci.wire_data[permWire.index].name.get();
-
-                switch (dName.back()) {
-                case '0':
-                    lut_init = 2;
-                    break;
-                case '1':
-                    lut_init = 4;
-                    break;
-                case '2':
-                    lut_init = 16;
-                    break;
-                case '3':
-                    lut_init = 256;
-                    break;
-                default:
-                    NPNR_ASSERT_FALSE("bad feedthru LUT input");
-                }
-                std::vector<bool> lc(20, false);
-                for (int i = 0; i < 16; i++) {
-                    if ((lut_init >> i) & 0x1)
-                        lc.at(lut_perm.at(i)) = true;
+    // Set pips, in the same order as getPips
+    std::vector<PipId> bound_pips = get_bound_pips(ctx);
+    std::sort(bound_pips.begin(), bound_pips.end());
+    for (auto pip : bound_pips) {
+        const PipInfoPOD &pi = ci.pip_data[pip.index];
+        const SwitchInfoPOD &swi = bi.switches[pi.switch_index];
+        int sw_bel_idx = swi.bel;
+        if (sw_bel_idx >= 0) {
+            const BelInfoPOD &beli = ci.bel_data[sw_bel_idx];
+            const TileInfoPOD &ti = bi.tiles_nonrouting[TILE_LOGIC];
+            BelId sw_bel;
+            sw_bel.index = sw_bel_idx;
+            NPNR_ASSERT(ctx->getBelType(sw_bel) == id_ICESTORM_LC);
+
+            if (ci.wire_data[ctx->getPipDstWire(pip).index].type == WireInfoPOD::WIRE_TYPE_LUTFF_IN_LUT)
+                continue; // Permutation pips
+            BelPin output = get_one_bel_pin(ctx, ctx->getPipDstWire(pip));
+            NPNR_ASSERT(output.bel == sw_bel && output.pin == id_O);
+            unsigned lut_init;
+
+            WireId permWire;
+            for (auto permPip : ctx->getPipsUphill(ctx->getPipSrcWire(pip))) {
+                if (ctx->getBoundPipNet(permPip) != nullptr) {
+                    permWire = ctx->getPipSrcWire(permPip);
                 }
+            }
+            NPNR_ASSERT(permWire != WireId());
+            std::string dName = ci.wire_data[permWire.index].name.get();
+
+            switch (dName.back()) {
+            case '0':
+                lut_init = 2;
+                break;
+            case '1':
+                lut_init = 4;
+                break;
+            case '2':
+                lut_init = 16;
+                break;
+            case '3':
+                lut_init = 256;
+                break;
+            default:
+                NPNR_ASSERT_FALSE("bad feedthru LUT input");
+            }
+            std::vector<bool> lc(20, false);
+            for (int i = 0; i < 16; i++) {
+                if ((lut_init >> i) & 0x1)
+                    lc.at(lut_perm.at(i)) = true;
+            }
 
-                for (int i = 0; i < 20; i++)
-                    set_config(ti, config.at(beli.y).at(beli.x), "LC_" + std::to_string(beli.z), lc.at(i), i);
-            } else {
-                for (int i = 0; i < swi.num_bits; i++) {
-                    bool val = (pi.switch_mask & (1 << ((swi.num_bits - 1) - i))) != 0;
-                    int8_t &cbit = config.at(swi.y).at(swi.x).at(swi.cbits[i].row).at(swi.cbits[i].col);
-                    if (bool(cbit) != 0)
-                        NPNR_ASSERT(false);
-                    cbit = val;
-                }
+            for (int i = 0; i < 20; i++)
+                set_config(ti, config.at(beli.y).at(beli.x), "LC_" + std::to_string(beli.z), lc.at(i), i);
+        } else {
+            for (int i = 0; i < swi.num_bits; i++) {
+                bool val = (pi.switch_mask & (1 << ((swi.num_bits - 1) - i))) != 0;
+                int8_t &cbit = config.at(swi.y).at(swi.x).at(swi.cbits[i].row).at(swi.cbits[i].col);
+                if (bool(cbit) != 0)
+                    NPNR_ASSERT(false);
+                cbit = val;
             }
         }
     }
@@ -903,11 +904,10 @@ void write_asc(const Context *ctx, std::ostream &out)
 
     // Write symbols
     // const bool write_symbols = 1;
-    for (auto wire : ctx->getWires()) {
-        NetInfo *net = ctx->getBoundWireNet(wire);
-        if (net != nullptr)
-            out << ".sym " << wire.index << " " << net->name.str(ctx) << std::endl;
-    }
+    std::vector<WireId> bound_wires = get_bound_wires(ctx);
+    std::sort(bound_wires.begin(), bound_wires.end());
+    for (auto wire : bound_wires)
+        out << ".sym " << wire.index << " " << ctx->getBoundWireNet(wire)->name.str(ctx) << std::endl;
 }
 
 void read_config(Context *ctx, std::istream &in, chipconfig_t &config)
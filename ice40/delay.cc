@@ -149,9 +149,25 @@ struct model_params_t
 
 } // namespace
 
+void Arch::init_delay_lookahead()
+{
+    if (!DelayLookahead::enabled(getCtx()))
+        return;
+    wire_lookahead_class.resize(chip_info->wire_data.size());
+    for (int i = 0; i < chip_info->wire_data.ssize(); i++)
+        wire_lookahead_class[i] = delay_lookahead.class_of(chip_info->wire_data[i].name.get());
+    delay_lookahead.init(getCtx(), stringf("ice40-%s", archArgsToId(args).c_str(this)),
+                         [this](WireId wire) { return lookahead_wire(wire); });
+}
+
 delay_t Arch::estimateDelay(WireId src, WireId dst) const
 {
     NPNR_ASSERT(src != WireId());
+    if (delay_lookahead.ready()) {
+        delay_t v = delay_lookahead.estimate(lookahead_wire(src), lookahead_wire(dst));
+        if (v >= 0)
+            return v;
+    }
     int x1 = chip_info->wire_data[src.index].x;
     int y1 = chip_info->wire_data[src.index].y;
     int z1 = chip_info->wire_data[src.index].z;
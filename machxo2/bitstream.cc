@@ -22,6 +22,7 @@
 
 #include "bitstream.h"
 #include "config.h"
+#include "design_utils.h"
 #include "nextpnr.h"
 #include "util.h"
 
@@ -162,12 +163,12 @@ void write_bitstream(Context *ctx, std::string text_config_file)
 
     cc.metadata.push_back("Part: " + ctx->get_full_chip_name());
 
-    // Add all set, configurable pips to the config
-    for (auto pip : ctx->getPips()) {
-        if (ctx->getBoundPipNet(pip) != nullptr) {
-            if (ctx->get_pip_class(pip) == 0) { // ignore fixed pips
-                set_pip(ctx, cc, pip);
-            }
+    // Add all set, configurable pips to the config, in the same order as getPips
+    std::vector<PipId> bound_pips = get_bound_pips(ctx);
+    std::sort(bound_pips.begin(), bound_pips.end());
+    for (auto pip : bound_pips) {
+        if (ctx->get_pip_class(pip) == 0) { // ignore fixed pips
+            set_pip(ctx, cc, pip);
         }
     }
 
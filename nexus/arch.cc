@@ -105,6 +105,11 @@ Arch::Arch(ArchArgs args) : args(args)
     for (size_t i = 0; i < chip_info->grid.size(); i++) {
         tileStatus[i].boundcells.resize(db->loctypes[chip_info->grid[i].loc_type].bels.size());
     }
+    tile_wire_index_base.reserve(chip_info->grid.size());
+    for (size_t i = 0; i < chip_info->grid.size(); i++) {
+        tile_wire_index_base.push_back(wire_index_count);
+        wire_index_count += db->loctypes[chip_info->grid[i].loc_type].wires.ssize();
+    }
     // This structure is needed for a fast getBelByLocation because bels can have an offset
     for (size_t i = 0; i < chip_info->grid.size(); i++) {
         auto &loc = db->loctypes[chip_info->grid[i].loc_type];
@@ -563,8 +568,25 @@ TimingClockingInfo Arch::getPortClockingInfo(const CellInfo *cell, IdString port
 
 // -----------------------------------------------------------------------
 
+void Arch::init_delay_lookahead()
+{
+    if (!DelayLookahead::enabled(getCtx()))
+        return;
+    wire_lookahead_class.resize(db->loctypes.size());
+    for (int lt = 0; lt < db->loctypes.ssize(); lt++)
+        for (auto &wire : db->loctypes[lt].wires)
+            wire_lookahead_class[lt].push_back(delay_lookahead.class_of(IdString(wire.name).str(this)));
+    delay_lookahead.init(getCtx(), stringf("nexus-%s", archArgsToId(args).c_str(this)),
+                         [this](WireId wire) { return lookahead_wire(wire); });
+}
+
 delay_t Arch::estimateDelay(WireId src, WireId dst) const
 {
+    if (delay_lookahead.ready()) {
+        delay_t v = delay_lookahead.estimate(lookahead_wire(src), lookahead_wire(dst));
+        if (v >= 0)
+            return v;
+    }
     int src_x = src.tile % chip_info->width, src_y = src.tile / chip_info->width;
     int dst_x = dst.tile % chip_info->width, dst_y = dst.tile / chip_info->width;
     int dist_x = std::abs(src_x - dst_x);
@@ -684,6 +706,7 @@ bool Arch::route()
     pre_routing();
 
     route_globals();
+    init_delay_lookahead();
 
     std::string router = str_or_default(settings, id("router"), defaultRouter);
     bool result;
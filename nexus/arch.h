@@ -25,6 +25,7 @@
 #include <iostream>
 
 #include "base_arch.h"
+#include "delay_lookahead.h"
 #include "nextpnr_namespaces.h"
 #include "nextpnr_types.h"
 #include "relptr.h"
@@ -913,6 +914,10 @@ struct Arch : BaseArch<ArchRanges>
 
     std::vector<TileStatus> tileStatus;
 
+    // Dense wire index of the first wire in each tile. Wires that aren't the primary wire of their node leave gaps
+    std::vector<int> tile_wire_index_base;
+    int wire_index_count = 0;
+
     // fast access to  X and Y IdStrings for building object names
     std::vector<IdString> x_ids, y_ids;
     // inverse of the above for name->object mapping
@@ -1046,6 +1051,9 @@ struct Arch : BaseArch<ArchRanges>
 
     DelayQuad getWireDelay(WireId wire) const override { return DelayQuad(0); }
 
+    int getWireIndexCount() const override { return wire_index_count; }
+    int getWireIndex(WireId wire) const override { return tile_wire_index_base[wire.tile] + wire.index; }
+
     BelPinRange getWireBelPins(WireId wire) const override
     {
         BelPinRange range;
@@ -1181,6 +1189,19 @@ struct Arch : BaseArch<ArchRanges>
     void pre_routing();
     std::unordered_set<WireId> dsp_wires, lram_wires;
 
+    // Sampled routing delays used by estimateDelay, if enabled; wire classes are indexed by location type then wire
+    DelayLookahead delay_lookahead;
+    std::vector<std::vector<int>> wire_lookahead_class;
+    void init_delay_lookahead();
+    LookaheadWire lookahead_wire(WireId wire) const
+    {
+        LookaheadWire lw;
+        lw.cls = wire_lookahead_class.at(chip_info->grid[wire.tile].loc_type).at(wire.index);
+        lw.x = wire.tile % chip_info->width;
+        lw.y = wire.tile / chip_info->width;
+        return lw;
+    }
+
     // -------------------------------------------------
 
     // Get the delay through a cell from one port to another, returning false
@@ -1198,6 +1219,8 @@ struct Arch : BaseArch<ArchRanges>
 
     // Return true whether all Bels at a given location are valid
     bool isBelLocationValid(BelId bel) const override;
+    // Binding only touches the status of the bel's tile, which is also all that validity depends on
+    bool isBelBindLocal(BelId bel) const override { return true; }
 
     // -------------------------------------------------
 